@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui
+QT       += core gui concurrent network
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -18,19 +18,63 @@ SOURCES += src/main.cpp\
     src/viewwidget.cpp \
    src/matrixeditor.cpp \
     src/rotationeditor.cpp \
+    src/hsveditor.cpp \
     src/quaternion.cpp \
     src/vector3.cpp \
-    src/pigmenteditor.cpp
+    src/pigmenteditor.cpp \
+    src/colortransform.cpp \
+    src/imagetransform.cpp \
+    src/sweepdialog.cpp \
+    src/comparisongrid.cpp \
+    src/comparisondialog.cpp \
+    src/histogramview.cpp \
+    src/validation.cpp \
+    src/renderdaemon.cpp \
+    src/folderwatcher.cpp \
+    src/tilestore.cpp \
+    src/examplefit.cpp \
+    src/fitdialog.cpp \
+    src/framestream.cpp \
+    src/timeline.cpp \
+    src/imagesequence.cpp \
+    src/scheduler.cpp \
+    src/imagemimedata.cpp \
+    src/memoryaccountant.cpp \
+    src/sessionrecorder.cpp
 
 HEADERS  += src/mainwindow.h \
     src/viewwidget.h \
     src/matrixeditor.h \
     src/rotationeditor.h \
+    src/hsveditor.h \
     src/quaternion.h \
     src/vector3.h \
-    src/pigmenteditor.h
+    src/pigmenteditor.h \
+    src/colortransform.h \
+    src/imagetransform.h \
+    src/sweepdialog.h \
+    src/comparisongrid.h \
+    src/comparisondialog.h \
+    src/histogramview.h \
+    src/validation.h \
+    src/renderdaemon.h \
+    src/folderwatcher.h \
+    src/tilestore.h \
+    src/examplefit.h \
+    src/fitdialog.h \
+    src/framestream.h \
+    src/timeline.h \
+    src/imagesequence.h \
+    src/scheduler.h \
+    src/imagemimedata.h \
+    src/memoryaccountant.h \
+    src/sessionrecorder.h
 
 FORMS    += src/mainwindow.ui \
    src/matrixeditor.ui \
     src/rotationeditor.ui \
-    src/pigmenteditor.ui
+    src/hsveditor.ui \
+    src/pigmenteditor.ui \
+    src/sweepdialog.ui \
+    src/comparisondialog.ui \
+    src/fitdialog.ui
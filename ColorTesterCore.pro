@@ -0,0 +1,29 @@
+#-------------------------------------------------
+#
+# Shared library exposing the color transforms through a C interface,
+# see src/colortester.h. Does not depend on Qt.
+#
+#-------------------------------------------------
+
+CONFIG  -= qt
+CONFIG  += shared c++11
+
+TARGET = colortester
+TEMPLATE = lib
+VERSION = 1.0.0
+
+DEFINES += COLORTESTER_LIBRARY
+
+INCLUDEPATH += src
+
+SOURCES += src/colortester.cpp \
+    src/colortransform.cpp \
+    src/quaternion.cpp \
+    src/vector3.cpp
+
+HEADERS += src/colortester.h \
+    src/colortransform.h \
+    src/quaternion.h \
+    src/vector3.h
+
+unix: LIBS += -lpthread
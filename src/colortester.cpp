@@ -0,0 +1,299 @@
+#include "colortester.h"
+#include "colortransform.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+static_assert(CT_MATRIX_ROWS == MATRIX_ROWS && CT_MATRIX_COLS == MATRIX_COLS, "C matrix layout must match the viewer's");
+
+//rows are converted through stack buffers of this many pixels, which also makes in place calls safe
+static const int chunkSize = 256;
+
+static uint32_t load(const uint8_t * p, ct_format format)
+{
+	return format == CT_FORMAT_RGBA8
+		? ColorTransform::rgba(p[0], p[1], p[2], p[3])
+		: ColorTransform::rgba(p[2], p[1], p[0], p[3]);
+}
+
+static void store(uint8_t * p, uint32_t pixel, ct_format format)
+{
+	p[format == CT_FORMAT_RGBA8? 0 : 2] = ColorTransform::red(pixel);
+	p[1]                                = ColorTransform::green(pixel);
+	p[format == CT_FORMAT_RGBA8? 2 : 0] = ColorTransform::blue(pixel);
+	p[3]                                = ColorTransform::alpha(pixel);
+}
+
+static bool valid(const ct_image * image)
+{
+	return image && image->pixels && image->width >= 0 && image->height >= 0
+		&& (image->format == CT_FORMAT_BGRA8 || image->format == CT_FORMAT_RGBA8);
+}
+
+static bool sameSize(const ct_image * a, const ct_image * b)
+{
+	return a->width == b->width && a->height == b->height;
+}
+
+template<typename Band>
+static void callBand(const void * context, int begin, int end)
+{
+	(*(const Band *) context)(begin, end);
+}
+
+//the workers are started once, on the first call that asks for them, and wait for bands from then on;
+//a call takes no heap memory and starts no thread unless it asks for more threads than any call before it
+class Pool
+{
+public:
+	typedef void (*BandFunction)(const void * context, int begin, int end);
+
+//the pool lives as long as the process, workers blocked on it are simply ended at exit
+	static Pool & instance()
+	{
+		static Pool * pool = new Pool();
+		return *pool;
+	}
+
+//height rows in threads bands, on the caller and up to threads-1 workers
+	void run(int threads, int height, BandFunction fn, const void * context)
+	{
+		Job job;
+		job.fn      = fn;
+		job.context = context;
+		job.height  = height;
+		job.bands   = threads;
+		job.next    = 0;
+		job.done    = 0;
+
+//one call uses the workers at a time, the others run their bands on their own threads rather than wait
+		std::unique_lock<std::mutex> owner(slot, std::try_to_lock);
+
+		if(!owner.owns_lock())
+		{
+			work(job);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			start(threads-1);
+			current = &job;
+			++generation;
+		}
+
+		wake.notify_all();
+		work(job);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this, &job]() { return job.done == job.bands && active == 0; });
+		current = nullptr;
+	}
+
+private:
+	enum { maxWorkers = 64 };
+
+	struct Job
+	{
+		BandFunction     fn;
+		const void *     context;
+		int              height;
+		int              bands;
+		std::atomic<int> next;
+		std::atomic<int> done;
+	};
+
+	Pool() : started(0), generation(0), current(nullptr), active(0)
+	{
+	}
+
+//claims bands until none are left
+	static void work(Job & job)
+	{
+		for(int i = job.next++; i < job.bands; i = job.next++)
+		{
+			job.fn(job.context, (int64_t) job.height * i / job.bands, (int64_t) job.height * (i+1) / job.bands);
+			++job.done;
+		}
+	}
+
+//no exception may leave the C entry points: if the system refuses another thread, the threads there are take its bands
+	void start(int count)
+	{
+		count = std::min<int>(count, maxWorkers);
+
+		try
+		{
+			for(; started < count; ++started)
+			{
+				workers[started] = std::thread(&Pool::loop, this);
+			}
+		}
+		catch(const std::exception &)
+		{
+		}
+	}
+
+	void loop()
+	{
+		unsigned seen = 0;
+
+		for(;;)
+		{
+			Job * job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this, seen]() { return current && generation != seen; });
+				seen = generation;
+				job  = current;
+				++active;
+			}
+
+			work(*job);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				--active;
+			}
+
+			finished.notify_all();
+		}
+	}
+
+	std::mutex              slot;
+	std::mutex              mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	std::thread             workers[maxWorkers];
+	int                     started;
+	unsigned                generation;
+	Job *                   current;
+	int                     active;
+};
+
+//kernel(dst, src, mod, width) works on one chunk of converted pixels
+template<typename Kernel>
+static int run(const ct_image * src, const ct_image * mod, ct_image * dst, int threads, const Kernel & kernel)
+{
+	if(!valid(src) || !valid(dst) || (mod && !valid(mod)))
+	{
+		return CT_ERROR_ARGUMENT;
+	}
+
+	if(!sameSize(src, dst) || (mod && !sameSize(src, mod)))
+	{
+		return CT_ERROR_SIZE;
+	}
+
+	auto band = [src, mod, dst, &kernel](int begin, int end)
+	{
+		uint32_t in[chunkSize], out[chunkSize], extra[chunkSize];
+
+		for(int y = begin; y < end; ++y)
+		{
+			const uint8_t * s = (const uint8_t *) src->pixels + y * src->stride;
+			const uint8_t * m = mod? (const uint8_t *) mod->pixels + y * mod->stride : nullptr;
+			uint8_t *       d = (uint8_t *) dst->pixels + y * dst->stride;
+
+			for(int x = 0; x < src->width; x += chunkSize)
+			{
+				const int n = std::min(chunkSize, src->width - x);
+
+				for(int i = 0; i < n; ++i)
+				{
+					in[i]  = load(s + (x+i)*4, src->format);
+					out[i] = 0;
+				}
+
+				if(m)
+				{
+					for(int i = 0; i < n; ++i)
+					{
+						extra[i] = load(m + (x+i)*4, mod->format);
+					}
+				}
+
+				kernel(out, in, m? extra : nullptr, n);
+
+				for(int i = 0; i < n; ++i)
+				{
+					store(d + (x+i)*4, out[i], dst->format);
+				}
+			}
+		}
+	};
+
+	if(threads <= 0)
+	{
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	threads = std::max(1, std::min(threads, src->height));
+
+	if(threads == 1)
+	{
+		band(0, src->height);
+		return CT_OK;
+	}
+
+	Pool::instance().run(threads, src->height, &callBand<decltype(band)>, &band);
+	return CT_OK;
+}
+
+extern "C" {
+
+int ct_version(void)
+{
+	return CT_VERSION;
+}
+
+int ct_apply_matrix(const ct_image * src, const ct_image * modifier, ct_image * dst, const uint8_t * weights, int threads)
+{
+	if(!weights) return CT_ERROR_ARGUMENT;
+
+	float mat[MATRIX_SIZE];
+	ColorTransform::prepareMatrix(mat, weights);
+
+	return run(src, modifier, dst, threads, [&mat](uint32_t * out, const uint32_t * in, const uint32_t * mod, int n)
+	{
+		ColorTransform::matrixRow(out, in, mod, n, mat);
+	});
+}
+
+int ct_apply_rotation(const ct_image * src, ct_image * dst, const uint8_t * angles, int threads)
+{
+	if(!angles) return CT_ERROR_ARGUMENT;
+
+	const Quaternion q = ColorTransform::prepareAngles(angles);
+
+	return run(src, nullptr, dst, threads, [&q](uint32_t * out, const uint32_t * in, const uint32_t *, int n)
+	{
+		ColorTransform::anglesRow(out, in, n, q);
+	});
+}
+
+int ct_apply_pigments(const ct_image * src, ct_image * dst, const uint8_t * pigments, int threads)
+{
+	if(!pigments) return CT_ERROR_ARGUMENT;
+
+	return run(src, nullptr, dst, threads, [pigments](uint32_t * out, const uint32_t * in, const uint32_t *, int n)
+	{
+		Vector3 swap[chunkSize];
+		ColorTransform::swapRow(swap, in, n, pigments);
+		ColorTransform::tintRow(out, in, swap, n, pigments);
+	});
+}
+
+int ct_apply_negate(const ct_image * src, ct_image * dst, int threads)
+{
+	return run(src, nullptr, dst, threads, [](uint32_t * out, const uint32_t * in, const uint32_t *, int n)
+	{
+		ColorTransform::negateRow(out, in, n);
+	});
+}
+
+}
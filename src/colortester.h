@@ -0,0 +1,72 @@
+#ifndef COLORTESTER_H
+#define COLORTESTER_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C interface to the ColorTester transforms over caller owned pixel buffers.
+ * Buffers are processed in place (dst == src) or out of place, nothing is allocated per call, row or pixel;
+ * worker threads are started by the first call that needs them and kept for the next.
+ * Transparent pixels come out as 0, like the viewer's renders.
+ * threads: 0 uses every core, 1 runs on the calling thread.
+ * Every call returns CT_OK or a negative CT_ERROR_ code.
+ */
+
+#if defined(_WIN32)
+#  if defined(COLORTESTER_LIBRARY)
+#    define CT_API __declspec(dllexport)
+#  else
+#    define CT_API __declspec(dllimport)
+#  endif
+#else
+#  define CT_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CT_VERSION 1
+
+#define CT_MATRIX_ROWS 3
+#define CT_MATRIX_COLS 5
+
+typedef enum ct_format
+{
+	CT_FORMAT_BGRA8 = 0,	/* bytes B, G, R, A; QImage::Format_ARGB32 on little endian machines */
+	CT_FORMAT_RGBA8 = 1		/* bytes R, G, B, A; QImage::Format_RGBA8888 */
+} ct_format;
+
+typedef enum ct_error
+{
+	CT_OK                 =  0,
+	CT_ERROR_ARGUMENT     = -1,
+	CT_ERROR_SIZE         = -2,
+	CT_ERROR_FORMAT       = -3
+} ct_error;
+
+typedef struct ct_image
+{
+	void *    pixels;
+	int       width;
+	int       height;
+	ptrdiff_t stride;		/* bytes from one row to the next */
+	ct_format format;
+} ct_image;
+
+CT_API int ct_version(void);
+
+/* weights are row major like MainWindow::matrix: output red, green, blue by input red, green, blue, modifier red, modifier green.
+ * modifier may be null, otherwise it must be the same size as src. */
+CT_API int ct_apply_matrix(const ct_image * src, const ct_image * modifier, ct_image * dst,
+						   const uint8_t weights[CT_MATRIX_ROWS*CT_MATRIX_COLS], int threads);
+
+CT_API int ct_apply_rotation(const ct_image * src, ct_image * dst, const uint8_t angles[3], int threads);
+CT_API int ct_apply_pigments(const ct_image * src, ct_image * dst, const uint8_t pigments[6], int threads);
+CT_API int ct_apply_negate  (const ct_image * src, ct_image * dst, int threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* COLORTESTER_H */
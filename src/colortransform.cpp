@@ -0,0 +1,1107 @@
+#include "colortransform.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358
+#endif
+
+void RenderStats::clear()
+{
+	memset(this, 0, sizeof(*this));
+}
+
+void RenderStats::merge(const RenderStats & it)
+{
+	for(int c = 0; c < Channels; ++c)
+	{
+		for(int i = 0; i < 256; ++i)
+		{
+			histogram[c][i] += it.histogram[c][i];
+		}
+	}
+
+	for(int c = 0; c < 3; ++c)
+	{
+		clamped[c] += it.clamped[c];
+	}
+
+	pixels += it.pixels;
+}
+
+void RenderStats::add(uint32_t pixel)
+{
+	int r = ColorTransform::red(pixel);
+	int g = ColorTransform::green(pixel);
+	int b = ColorTransform::blue(pixel);
+
+	++histogram[Red][r];
+	++histogram[Green][g];
+	++histogram[Blue][b];
+	++histogram[Luma][(r*299 + g*587 + b*114 + 500) / 1000];
+	++pixels;
+}
+
+int RenderStats::minimum(int channel) const
+{
+	for(int i = 0; i < 256; ++i)
+	{
+		if(histogram[channel][i]) return i;
+	}
+
+	return 0;
+}
+
+int RenderStats::maximum(int channel) const
+{
+	for(int i = 255; i >= 0; --i)
+	{
+		if(histogram[channel][i]) return i;
+	}
+
+	return 0;
+}
+
+double RenderStats::mean(int channel) const
+{
+	if(pixels == 0)
+	{
+		return 0;
+	}
+
+	uint64_t sum = 0;
+	for(int i = 0; i < 256; ++i)
+	{
+		sum += (uint64_t) histogram[channel][i] * i;
+	}
+
+	return sum / (double) pixels;
+}
+
+namespace ColorTransform
+{
+
+static uint8_t multiplyRow(const float * row, const uint8_t * colors, bool & clamped)
+{
+	float r = 0;
+	for(int i = 0; i < MATRIX_COLS; ++i)
+	{
+		r += colors[i] * row[i];
+	}
+
+	clamped = r < 0 || r > 255;
+	return r < 0? 0 : r < 255? (uint8_t) r : 255;
+}
+
+//same as Vector3::red() and friends, but reports whether the clamp kicked in
+static int toChannel(float v, bool & clamped)
+{
+	int c = (int) (v * 128 + 127);
+	clamped = c < 0 || c > 255;
+	return std::max(0, std::min(255, c));
+}
+
+static float saturate(float v, bool & clamped)
+{
+	clamped |= v < 0.f || v > 1.f;
+	return std::max(0.f, std::min(1.f, v));
+}
+
+//stats pass after a branch free kernel, counting the pixels the kernel wrote
+static void visibleStatsRow(const uint32_t * dst, const uint32_t * src, int width, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		if(alpha(src[x]) != 0)
+		{
+			stats->add(dst[x]);
+		}
+	}
+}
+
+void prepareMatrix(float * mat, const uint8_t * matrix)
+{
+	for(size_t y = 0; y < MATRIX_ROWS; ++y)
+	{
+		float sum = 0;
+		for(size_t x = 0; x < MATRIX_COLS; ++x)
+		{
+			int i = y*MATRIX_COLS + x;
+			mat[i] = matrix[i] / 255.0;
+			sum += mat[i];
+		}
+
+		if(sum > 1.0)
+		{
+			for(size_t x = 0; x < MATRIX_COLS; ++x)
+			{
+				int i = y*MATRIX_COLS + x;
+				mat[i] = mat[i] / sum;
+			}
+		}
+	}
+}
+
+Quaternion prepareAngles(const uint8_t * angles)
+{
+	return Quaternion(angles[0] * M_PI / 128, angles[1] * M_PI / 128, angles[2] * M_PI / 128);
+}
+
+void prepareHSV(float * mat, const uint8_t * hsv)
+{
+	const double H = hsv[0] * M_PI / 128;
+	const double S = hsv[1] / 128.0;
+	const double V = hsv[2] / 128.0;
+
+	const double VSU = V*S*std::cos(H);
+	const double VSW = V*S*std::sin(H);
+
+//the coefficients of TransformHSV, computed once instead of per pixel
+	const double m[9] =
+	{
+		.299*V + .701*VSU + .168*VSW, .587*V - .587*VSU + .330*VSW, .114*V - .114*VSU - .497*VSW,
+		.299*V - .299*VSU - .328*VSW, .587*V + .413*VSU + .035*VSW, .114*V - .114*VSU + .292*VSW,
+		.299*V - .300*VSU + 1.25*VSW, .587*V - .588*VSU - 1.05*VSW, .114*V + .886*VSU - .203*VSW
+	};
+
+	for(int i = 0; i < 9; ++i)
+	{
+		mat[i] = m[i];
+	}
+}
+
+void statsRow(const uint32_t * src, int width, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		if(alpha(src[x]) != 0)
+		{
+			stats->add(src[x]);
+		}
+	}
+}
+
+void negateRow(uint32_t * dst, const uint32_t * src, int width, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t pixel = src[x];
+
+		if(alpha(pixel) == 0)
+		{
+			continue;
+		}
+
+		dst[x] = rgba(-red(pixel) & 0xFF, -green(pixel) & 0xFF, -blue(pixel) & 0xFF, alpha(pixel));
+
+		if(stats) stats->add(dst[x]);
+	}
+}
+
+void matrixRow(uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const float * mat, int channels, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t pixel = src[x];
+
+		if(alpha(pixel) == 0)
+		{
+			continue;
+		}
+
+		uint8_t colors[MATRIX_COLS];
+
+		colors[0] = red(pixel);
+		colors[1] = green(pixel);
+		colors[2] = blue(pixel);
+
+		if(mod == nullptr)
+		{
+			colors[3] = 0;
+			colors[4] = 0;
+		}
+		else
+		{
+			colors[3] = red(mod[x]);
+			colors[4] = green(mod[x]);
+		}
+
+		uint32_t prev = dst[x];
+		bool cr = false, cg = false, cb = false;
+
+		uint8_t r = channels & 0x01? multiplyRow(mat + 0*MATRIX_COLS, colors, cr) : red(prev);
+		uint8_t g = channels & 0x02? multiplyRow(mat + 1*MATRIX_COLS, colors, cg) : green(prev);
+		uint8_t b = channels & 0x04? multiplyRow(mat + 2*MATRIX_COLS, colors, cb) : blue(prev);
+
+		dst[x] = rgba(r, g, b, alpha(pixel));
+
+		if(stats)
+		{
+			stats->add(dst[x]);
+			stats->clamp(cr, cg, cb);
+		}
+	}
+}
+
+void anglesRow(uint32_t * dst, const uint32_t * src, int width, const Quaternion & q, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t pixel = src[x];
+
+		if(alpha(pixel) == 0)
+		{
+			continue;
+		}
+
+		Vector3 c = Vector3::fromColor(red(pixel), green(pixel), blue(pixel));
+		float length = c.length();
+		c = q.rotate(c);
+		c.normalize();
+		c = c * length;
+
+		bool cr, cg, cb;
+		int r = toChannel(c.x, cr);
+		int g = toChannel(c.y, cg);
+		int b = toChannel(c.z, cb);
+
+		dst[x] = rgba(r, g, b, alpha(pixel));
+
+		if(stats)
+		{
+			stats->add(dst[x]);
+			stats->clamp(cr, cg, cb);
+		}
+	}
+}
+
+void hsvRow(uint32_t * dst, const uint32_t * src, int width, const float * mat, RenderStats * stats)
+{
+	const float m0 = mat[0], m1 = mat[1], m2 = mat[2];
+	const float m3 = mat[3], m4 = mat[4], m5 = mat[5];
+	const float m6 = mat[6], m7 = mat[7], m8 = mat[8];
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t pixel = src[x];
+		const float r = red(pixel);
+		const float g = green(pixel);
+		const float b = blue(pixel);
+
+		const float R = m0*r + m1*g + m2*b;
+		const float G = m3*r + m4*g + m5*b;
+		const float B = m6*r + m7*g + m8*b;
+
+		const uint32_t visible = alpha(pixel) != 0;
+
+		cr += visible & ((R < 0.f) | (R > 255.f));
+		cg += visible & ((G < 0.f) | (G > 255.f));
+		cb += visible & ((B < 0.f) | (B > 255.f));
+
+		const uint32_t out = rgba((int) std::max(0.f, std::min(255.f, R)),
+								  (int) std::max(0.f, std::min(255.f, G)),
+								  (int) std::max(0.f, std::min(255.f, B)), alpha(pixel));
+
+		dst[x] = visible? out : dst[x];
+	}
+
+	if(stats)
+	{
+		stats->clamped[RenderStats::Red]   += cr;
+		stats->clamped[RenderStats::Green] += cg;
+		stats->clamped[RenderStats::Blue]  += cb;
+		visibleStatsRow(dst, src, width, stats);
+	}
+}
+
+//Quaternion::rotate written out as a matrix; a unit quaternion keeps the length, so no sqrt is needed to restore it
+static void rotationMatrix(const Quaternion & q, float * m, float * k)
+{
+	const float w = q.w, ux = q.x, uy = q.y, uz = q.z;
+	const float s = w*w - (ux*ux + uy*uy + uz*uz);
+
+	const float r[9] =
+	{
+		2*ux*ux + s,    2*ux*uy - 2*w*uz, 2*ux*uz + 2*w*uy,
+		2*uy*ux + 2*w*uz, 2*uy*uy + s,    2*uy*uz - 2*w*ux,
+		2*uz*ux - 2*w*uy, 2*uz*uy + 2*w*ux, 2*uz*uz + s
+	};
+
+	memcpy(m, r, sizeof(r));
+
+//fromColor subtracts 127 and divides by 128, red() multiplies by 128 and adds 127; fold both into an offset
+	for(int o = 0; o < 3; ++o)
+	{
+		k[o] = 127 - 127 * (m[o*3] + m[o*3+1] + m[o*3+2]);
+	}
+}
+
+void anglesRowFast(uint32_t * dst, const uint32_t * src, int width, const Quaternion & q, RenderStats * stats)
+{
+	float m[9], k[3];
+	rotationMatrix(q, m, k);
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t pixel = src[x];
+		const float r = red(pixel);
+		const float g = green(pixel);
+		const float b = blue(pixel);
+
+		const float R = m[0]*r + m[1]*g + m[2]*b + k[0];
+		const float G = m[3]*r + m[4]*g + m[5]*b + k[1];
+		const float B = m[6]*r + m[7]*g + m[8]*b + k[2];
+
+		const uint32_t visible = alpha(pixel) != 0;
+
+		cr += visible & ((R <= -1.f) | (R >= 256.f));
+		cg += visible & ((G <= -1.f) | (G >= 256.f));
+		cb += visible & ((B <= -1.f) | (B >= 256.f));
+
+		const uint32_t out = rgba((int) std::max(0.f, std::min(255.f, R)),
+								  (int) std::max(0.f, std::min(255.f, G)),
+								  (int) std::max(0.f, std::min(255.f, B)), alpha(pixel));
+
+		dst[x] = visible? out : dst[x];
+	}
+
+	if(stats)
+	{
+		stats->clamped[RenderStats::Red]   += cr;
+		stats->clamped[RenderStats::Green] += cg;
+		stats->clamped[RenderStats::Blue]  += cb;
+		visibleStatsRow(dst, src, width, stats);
+	}
+}
+
+void swapRow(Vector3 * dst, const uint32_t * src, int width, const uint8_t * pigments)
+{
+	const float swap_rg = (pigments[3] > 128? pigments[3] - 128 : 128 - pigments[3])/128.f;
+	const float swap_gb = (pigments[4] > 128? pigments[4] - 128 : 128 - pigments[4])/128.f;
+	const float swap_rb = (pigments[5] > 128? pigments[5] - 128 : 128 - pigments[5])/128.f;
+
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t px = src[x];
+
+		if(alpha(px) == 0)
+			continue;
+
+		Vector3 color(red(px)/256.f, green(px)/256.f, blue(px)/256.f);
+
+		dst[x] = Vector3(color.x*(1-swap_rg)*(1-swap_rb) + color.y*(swap_rg) + color.z*(swap_rb)
+		,
+						color.y*(1-swap_rg)*(1-swap_gb) + color.x*(swap_rg) + color.z*(swap_gb)
+		,
+						color.z*(1-swap_gb)*(1-swap_rb) + color.x*(swap_rb) + color.y*(swap_gb)
+		);
+	}
+}
+
+void tintRow(uint32_t * dst, const uint32_t * src, const Vector3 * swapped, int width, const uint8_t * pigments, RenderStats * stats)
+{
+	float Pr = (pigments[0]/128.f);
+	float Pg = (pigments[1]/128.f);
+	float Pb = (pigments[2]/128.f);
+
+	float db = (Pr + Pg + Pb)/6 -.5;
+
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t px = src[x];
+
+		if(alpha(px) == 0)
+			continue;
+
+		Vector3 color(red(px)/256.f, green(px)/256.f, blue(px)/256.f);
+		float brightness = (color.x + color.y+color.z)/3;// sqrt(color.x*color.x*.241 + color.y*color.y*.691+ color.z*color.z*.068);
+
+		float t = (brightness)*(1-brightness);
+
+		float chroma = std::max(color.x, std::max(color.y, color.z)) -  std::min(color.x, std::min(color.y, color.z));
+
+		color = swapped[x];
+
+		color.x = color.x*(1-chroma) + (Pr <= 1.f? Pr*color.x : color.x + (1-color.x)*(Pr-1))*chroma + db;
+		color.y = color.y*(1-chroma) + (Pg <= 1.f? Pg*color.y : color.y + (1-color.y)*(Pg-1))*chroma + db;
+		color.z = color.z*(1-chroma) + (Pb <= 1.f? Pb*color.z : color.z + (1-color.z)*(Pb-1))*chroma + db;
+
+		bool cr = false, cg = false, cb = false;
+
+		color.x = saturate(color.x, cr);
+		color.y = saturate(color.y, cg);
+		color.z = saturate(color.z, cb);
+
+		float luma = (color.x + color.y+color.z)/3;
+		//sqrt(color.x*color.x*.241 + color.y*color.y*.691+ color.z*color.z*.068);
+
+		luma  = (brightness*(1-t) + luma*t) - luma;
+
+		color.x += luma;
+		color.y += luma;
+		color.z += luma;
+
+		color.x = saturate(color.x, cr);
+		color.y = saturate(color.y, cg);
+		color.z = saturate(color.z, cb);
+
+		dst[x] = rgba(color.x*255, color.y*255, color.z*255, alpha(px));
+
+		if(stats)
+		{
+			stats->add(dst[x]);
+			stats->clamp(cr, cg, cb);
+		}
+	}
+}
+
+//pigmentsRowFast's math, shared with the 16 bit and linear light kernels; scale takes channel values to the 0-1 of the swap stage
+struct PigmentMath
+{
+	float m[9], a[3], b[3], db, s;
+
+	PigmentMath(const uint8_t * pigments, float scale)
+	{
+		const float swap_rg = (pigments[3] > 128? pigments[3] - 128 : 128 - pigments[3])/128.f;
+		const float swap_gb = (pigments[4] > 128? pigments[4] - 128 : 128 - pigments[4])/128.f;
+		const float swap_rb = (pigments[5] > 128? pigments[5] - 128 : 128 - pigments[5])/128.f;
+
+//the swap stage as a matrix, on channel values so the scale folds into it too
+		s = scale;
+		const float swap[9] =
+		{
+			(1-swap_rg)*(1-swap_rb)*s, swap_rg*s, swap_rb*s,
+			swap_rg*s, (1-swap_rg)*(1-swap_gb)*s, swap_gb*s,
+			swap_rb*s, swap_gb*s, (1-swap_gb)*(1-swap_rb)*s
+		};
+
+		memcpy(m, swap, sizeof(m));
+
+//tintRow's per channel branch on P <= 1 is a line in the swapped color: c*(1-chroma) + (a*c + b)*chroma = c + chroma*((a-1)*c + b)
+		for(int c = 0; c < 3; ++c)
+		{
+			const float P = pigments[c]/128.f;
+			a[c] = P <= 1.f? P - 1 : 1 - P;
+			b[c] = P <= 1.f? 0 : P - 1;
+		}
+
+		db = (pigments[0]/128.f + pigments[1]/128.f + pigments[2]/128.f)/6 - .5f;
+	}
+
+//out is 0-1, clamped gets a set bit per channel that had to be clamped
+	inline void operator()(float r, float g, float bl, float * out, uint32_t * clamped) const
+	{
+		const float brightness = (r + g + bl) * (s/3);
+		const float t = brightness*(1-brightness);
+		const float chroma = (std::max(r, std::max(g, bl)) - std::min(r, std::min(g, bl))) * s;
+
+		const float sx = m[0]*r + m[1]*g + m[2]*bl;
+		const float sy = m[3]*r + m[4]*g + m[5]*bl;
+		const float sz = m[6]*r + m[7]*g + m[8]*bl;
+
+		float X = sx + chroma*(a[0]*sx + b[0]) + db;
+		float Y = sy + chroma*(a[1]*sy + b[1]) + db;
+		float Z = sz + chroma*(a[2]*sz + b[2]) + db;
+
+		uint32_t clampX = (X < 0.f) | (X > 1.f);
+		uint32_t clampY = (Y < 0.f) | (Y > 1.f);
+		uint32_t clampZ = (Z < 0.f) | (Z > 1.f);
+
+		X = std::max(0.f, std::min(1.f, X));
+		Y = std::max(0.f, std::min(1.f, Y));
+		Z = std::max(0.f, std::min(1.f, Z));
+
+		const float luma = (brightness - (X + Y + Z)*(1/3.f))*(1-t);
+
+		X += luma;
+		Y += luma;
+		Z += luma;
+
+		clamped[0] = clampX | (X < 0.f) | (X > 1.f);
+		clamped[1] = clampY | (Y < 0.f) | (Y > 1.f);
+		clamped[2] = clampZ | (Z < 0.f) | (Z > 1.f);
+
+		out[0] = std::max(0.f, std::min(1.f, X));
+		out[1] = std::max(0.f, std::min(1.f, Y));
+		out[2] = std::max(0.f, std::min(1.f, Z));
+	}
+};
+
+void pigmentsRowFast(uint32_t * dst, const uint32_t * src, int width, const uint8_t * pigments, RenderStats * stats)
+{
+	const PigmentMath math(pigments, 1/256.f);
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t pixel = src[x];
+
+		float out[3];
+		uint32_t clamped[3];
+		math(red(pixel), green(pixel), blue(pixel), out, clamped);
+
+		const uint32_t visible = alpha(pixel) != 0;
+
+		cr += visible & clamped[0];
+		cg += visible & clamped[1];
+		cb += visible & clamped[2];
+
+		const uint32_t result = rgba((int) (out[0]*255), (int) (out[1]*255), (int) (out[2]*255), alpha(pixel));
+		dst[x] = visible? result : dst[x];
+	}
+
+	if(stats)
+	{
+		stats->clamped[RenderStats::Red]   += cr;
+		stats->clamped[RenderStats::Green] += cg;
+		stats->clamped[RenderStats::Blue]  += cb;
+		visibleStatsRow(dst, src, width, stats);
+	}
+}
+
+bool lutSupported(RenderKind kind)
+{
+	return kind == RenderAngles || kind == RenderPigments || kind == RenderHSV;
+}
+
+//the 0-255 value a table level stands for, and the level nearest to a value
+static int lutLevel(int i) { return (i * 255 + (LutLevels-1)/2) / (LutLevels-1); }
+static int lutIndex(int v) { return (v * (LutLevels-1) + 127) / 255; }
+
+void buildLut(uint32_t * lut, const TransformParams & params)
+{
+	std::vector<uint32_t> row(LutLevels);
+	std::vector<Vector3>  swap(LutLevels);
+
+	const Quaternion q = prepareAngles(params.angles);
+	float hsv[9];
+	prepareHSV(hsv, params.hsv);
+
+//one row per red and green level, running along blue
+	for(int i = 0; i < LutLevels*LutLevels; ++i)
+	{
+		for(int x = 0; x < LutLevels; ++x)
+		{
+			row[x] = rgba(lutLevel(i / LutLevels), lutLevel(i % LutLevels), lutLevel(x), 255);
+		}
+
+		uint32_t * out = lut + i * LutLevels;
+
+		switch(params.kind)
+		{
+		case RenderAngles:
+			anglesRow(out, row.data(), LutLevels, q);
+			break;
+		case RenderPigments:
+			swapRow(swap.data(), row.data(), LutLevels, params.pigments);
+			tintRow(out, row.data(), swap.data(), LutLevels, params.pigments);
+			break;
+		case RenderHSV:
+			hsvRow(out, row.data(), LutLevels, hsv);
+			break;
+		default:
+			memcpy(out, row.data(), LutLevels * sizeof(uint32_t));
+			break;
+		}
+	}
+}
+
+void lutRow(uint32_t * dst, const uint32_t * src, int width, const uint32_t * lut, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		uint32_t pixel = src[x];
+
+		if(alpha(pixel) == 0)
+		{
+			continue;
+		}
+
+		const int i = (lutIndex(red(pixel)) << (2*LutBits)) | (lutIndex(green(pixel)) << LutBits) | lutIndex(blue(pixel));
+		dst[x] = (lut[i] & 0x00FFFFFF) | (pixel & 0xFF000000);
+
+		if(stats) stats->add(dst[x]);
+	}
+}
+
+bool prepareAffine(float * mat, float * offset, const TransformParams & params)
+{
+	memset(mat, 0, MATRIX_SIZE * sizeof(float));
+	memset(offset, 0, 3 * sizeof(float));
+
+	float m[9];
+
+	switch(params.kind)
+	{
+	case RenderMatrix:
+		prepareMatrix(mat, params.matrix);
+		return true;
+	case RenderAngles:
+		rotationMatrix(prepareAngles(params.angles), m, offset);
+		break;
+	case RenderHSV:
+		prepareHSV(m, params.hsv);
+		break;
+	default:
+		return false;
+	}
+
+	for(int y = 0; y < 3; ++y)
+	{
+		for(int x = 0; x < 3; ++x)
+		{
+			mat[y*MATRIX_COLS + x] = m[y*3 + x];
+		}
+	}
+
+	return true;
+}
+
+//histograms stay at 256 bins, a 16 bit channel counts in the bin of its high byte
+static void visibleStatsRow64(const uint64_t * dst, const uint64_t * src, int width, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		if(alpha16(src[x]) != 0)
+		{
+			const uint64_t p = dst[x];
+			stats->add(rgba(red16(p) >> 8, green16(p) >> 8, blue16(p) >> 8, alpha16(p) >> 8));
+		}
+	}
+}
+
+static void addClamps(RenderStats * stats, uint32_t cr, uint32_t cg, uint32_t cb)
+{
+	stats->clamped[RenderStats::Red]   += cr;
+	stats->clamped[RenderStats::Green] += cg;
+	stats->clamped[RenderStats::Blue]  += cb;
+}
+
+void statsRow64(const uint64_t * src, int width, RenderStats * stats)
+{
+	visibleStatsRow64(src, src, width, stats);
+}
+
+void negateRow64(uint64_t * dst, const uint64_t * src, int width, RenderStats * stats)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		const uint64_t pixel = src[x];
+		const uint64_t out = rgba64(-red16(pixel), -green16(pixel), -blue16(pixel), alpha16(pixel));
+
+		dst[x] = alpha16(pixel) != 0? out : dst[x];
+	}
+
+	if(stats) visibleStatsRow64(dst, src, width, stats);
+}
+
+void affineRow64(uint64_t * dst, const uint64_t * src, const uint64_t * mod, int width, const float * mat, const float * offset, int channels, RenderStats * stats)
+{
+//without a modifier its columns are zeroed and the source stands in, so the loop has no branch on it
+	float m[MATRIX_SIZE];
+	memcpy(m, mat, sizeof(m));
+
+	if(mod == nullptr)
+	{
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			m[y*MATRIX_COLS + 3] = 0;
+			m[y*MATRIX_COLS + 4] = 0;
+		}
+
+		mod = src;
+	}
+
+	const float k0 = offset[0] * 257, k1 = offset[1] * 257, k2 = offset[2] * 257;
+
+//channels not written keep the previous value of dst
+	const uint64_t keep = (channels & 0x01? 0 : 0xFFFFull) | (channels & 0x02? 0 : 0xFFFFull << 16) | (channels & 0x04? 0 : 0xFFFFull << 32);
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint64_t pixel = src[x];
+		const float r  = red16(pixel);
+		const float g  = green16(pixel);
+		const float b  = blue16(pixel);
+		const float mr = red16(mod[x]);
+		const float mg = green16(mod[x]);
+
+		const float R = m[0]*r + m[1]*g + m[2]*b + m[3]*mr + m[4]*mg + k0;
+		const float G = m[5]*r + m[6]*g + m[7]*b + m[8]*mr + m[9]*mg + k1;
+		const float B = m[10]*r + m[11]*g + m[12]*b + m[13]*mr + m[14]*mg + k2;
+
+		const uint32_t visible = alpha16(pixel) != 0;
+
+		cr += visible & ((R < 0.f) | (R > 65535.f));
+		cg += visible & ((G < 0.f) | (G > 65535.f));
+		cb += visible & ((B < 0.f) | (B > 65535.f));
+
+		const uint64_t out = rgba64((int) (std::max(0.f, std::min(65535.f, R)) + .5f),
+									(int) (std::max(0.f, std::min(65535.f, G)) + .5f),
+									(int) (std::max(0.f, std::min(65535.f, B)) + .5f), alpha16(pixel));
+
+		dst[x] = visible? (out & ~keep) | (dst[x] & keep) : dst[x];
+	}
+
+	if(stats)
+	{
+		addClamps(stats, channels & 0x01? cr : 0, channels & 0x02? cg : 0, channels & 0x04? cb : 0);
+		visibleStatsRow64(dst, src, width, stats);
+	}
+}
+
+//the 1/256 scale of pigmentsRowFast, applied to 16 bit values
+void pigmentsRow64(uint64_t * dst, const uint64_t * src, int width, const uint8_t * pigments, RenderStats * stats)
+{
+	const PigmentMath math(pigments, 1/(256.f*257.f));
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint64_t pixel = src[x];
+
+		float out[3];
+		uint32_t clamped[3];
+		math(red16(pixel), green16(pixel), blue16(pixel), out, clamped);
+
+		const uint32_t visible = alpha16(pixel) != 0;
+
+		cr += visible & clamped[0];
+		cg += visible & clamped[1];
+		cb += visible & clamped[2];
+
+		const uint64_t result = rgba64((int) (out[0]*65535 + .5f), (int) (out[1]*65535 + .5f), (int) (out[2]*65535 + .5f), alpha16(pixel));
+		dst[x] = visible? result : dst[x];
+	}
+
+	if(stats)
+	{
+		addClamps(stats, cr, cg, cb);
+		visibleStatsRow64(dst, src, width, stats);
+	}
+}
+
+//IEC 61966-2-1 curves, only evaluated while the tables are built
+static double srgbToLinear(double v)
+{
+	return v <= 0.04045? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+}
+
+static double linearToSrgb(double v)
+{
+	return v <= 0.0031308? v * 12.92 : 1.055 * std::pow(v, 1/2.4) - 0.055;
+}
+
+static LinearLight buildLinearLight()
+{
+	LinearLight tables;
+
+	for(int i = 0; i < 256; ++i)
+	{
+		tables.decode[i] = srgbToLinear(i / 255.0) * 255;
+	}
+
+	for(int i = 0; i <= 255*EncodeSteps; ++i)
+	{
+		tables.encode[i] = (uint8_t) std::lround(linearToSrgb(i / (255.0*EncodeSteps)) * 255);
+	}
+
+	return tables;
+}
+
+const LinearLight & linearLight()
+{
+	static const LinearLight tables = buildLinearLight();
+	return tables;
+}
+
+//a 0-255 linear value, clamped, to the nearest encode entry
+static inline int encodeIndex(float v)
+{
+	return (int) (std::max(0.f, std::min(255.f, v)) * EncodeSteps + .5f);
+}
+
+void affineRowLinear(uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const float * mat, const float * offset, int channels, RenderStats * stats)
+{
+	const LinearLight & light = linearLight();
+
+	float m[MATRIX_SIZE];
+	memcpy(m, mat, sizeof(m));
+
+	if(mod == nullptr)
+	{
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			m[y*MATRIX_COLS + 3] = 0;
+			m[y*MATRIX_COLS + 4] = 0;
+		}
+
+		mod = src;
+	}
+
+	const uint32_t keep = (channels & 0x01? 0 : 0xFF0000u) | (channels & 0x02? 0 : 0xFF00u) | (channels & 0x04? 0 : 0xFFu);
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t pixel = src[x];
+		const float r  = light.decode[red(pixel)];
+		const float g  = light.decode[green(pixel)];
+		const float b  = light.decode[blue(pixel)];
+		const float mr = light.decode[red(mod[x])];
+		const float mg = light.decode[green(mod[x])];
+
+		const float R = m[0]*r + m[1]*g + m[2]*b + m[3]*mr + m[4]*mg + offset[0];
+		const float G = m[5]*r + m[6]*g + m[7]*b + m[8]*mr + m[9]*mg + offset[1];
+		const float B = m[10]*r + m[11]*g + m[12]*b + m[13]*mr + m[14]*mg + offset[2];
+
+		const uint32_t visible = alpha(pixel) != 0;
+
+		cr += visible & ((R < 0.f) | (R > 255.f));
+		cg += visible & ((G < 0.f) | (G > 255.f));
+		cb += visible & ((B < 0.f) | (B > 255.f));
+
+		const uint32_t out = rgba(light.encode[encodeIndex(R)], light.encode[encodeIndex(G)], light.encode[encodeIndex(B)], alpha(pixel));
+
+		dst[x] = visible? (out & ~keep) | (dst[x] & keep) : dst[x];
+	}
+
+	if(stats)
+	{
+		addClamps(stats, channels & 0x01? cr : 0, channels & 0x02? cg : 0, channels & 0x04? cb : 0);
+		visibleStatsRow(dst, src, width, stats);
+	}
+}
+
+void pigmentsRowLinear(uint32_t * dst, const uint32_t * src, int width, const uint8_t * pigments, RenderStats * stats)
+{
+	const LinearLight & light = linearLight();
+	const PigmentMath math(pigments, 1/256.f);
+
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t pixel = src[x];
+
+		float out[3];
+		uint32_t clamped[3];
+		math(light.decode[red(pixel)], light.decode[green(pixel)], light.decode[blue(pixel)], out, clamped);
+
+		const uint32_t visible = alpha(pixel) != 0;
+
+		cr += visible & clamped[0];
+		cg += visible & clamped[1];
+		cb += visible & clamped[2];
+
+		const uint32_t result = rgba(light.encode[encodeIndex(out[0]*255)], light.encode[encodeIndex(out[1]*255)], light.encode[encodeIndex(out[2]*255)], alpha(pixel));
+		dst[x] = visible? result : dst[x];
+	}
+
+	if(stats)
+	{
+		addClamps(stats, cr, cg, cb);
+		visibleStatsRow(dst, src, width, stats);
+	}
+}
+
+void prepareWide(float * mat, const TransformParams & params)
+{
+	const int cols = 3 + params.modifierCount;
+	memset(mat, 0, WIDE_SIZE * sizeof(float));
+
+	for(int y = 0; y < MATRIX_ROWS; ++y)
+	{
+		float sum = 0;
+		for(int x = 0; x < cols; ++x)
+		{
+			int i = y*WIDE_COLS + x;
+			mat[i] = params.wide[i] / 255.0;
+			sum += mat[i];
+		}
+
+		if(sum > 1.0)
+		{
+			for(int x = 0; x < cols; ++x)
+			{
+				int i = y*WIDE_COLS + x;
+				mat[i] = mat[i] / sum;
+			}
+		}
+	}
+}
+
+//how the wide kernel reads and writes each pixel format; load turns a channel into the value the matrix mixes
+struct Encoded
+{
+	typedef uint32_t Pixel;
+	enum { Mask = 0xFF };
+
+	static int    shift(int channel) { static const int shifts[4] = { 16, 8, 0, 24 }; return shifts[channel & 3]; }
+	static int    alpha(Pixel p)     { return ColorTransform::alpha(p); }
+	static Pixel  keep(int channels) { return (channels & 0x01? 0 : 0xFF0000u) | (channels & 0x02? 0 : 0xFF00u) | (channels & 0x04? 0 : 0xFFu); }
+	static bool   clamped(float v)   { return (v < 0.f) | (v > 255.f); }
+
+	float load(int v) const          { return v; }
+	Pixel store(float r, float g, float b, int a) const
+	{
+		return rgba((int) std::max(0.f, std::min(255.f, r)), (int) std::max(0.f, std::min(255.f, g)), (int) std::max(0.f, std::min(255.f, b)), a);
+	}
+
+	static void stats(const Pixel * dst, const Pixel * src, int width, RenderStats * stats) { visibleStatsRow(dst, src, width, stats); }
+};
+
+struct Deep
+{
+	typedef uint64_t Pixel;
+	enum { Mask = 0xFFFF };
+
+	static int    shift(int channel) { return 16 * (channel & 3); }
+	static int    alpha(Pixel p)     { return alpha16(p); }
+	static Pixel  keep(int channels) { return (channels & 0x01? 0 : 0xFFFFull) | (channels & 0x02? 0 : 0xFFFFull << 16) | (channels & 0x04? 0 : 0xFFFFull << 32); }
+	static bool   clamped(float v)   { return (v < 0.f) | (v > 65535.f); }
+
+	float load(int v) const          { return v; }
+	Pixel store(float r, float g, float b, int a) const
+	{
+		return rgba64((int) (std::max(0.f, std::min(65535.f, r)) + .5f), (int) (std::max(0.f, std::min(65535.f, g)) + .5f),
+					  (int) (std::max(0.f, std::min(65535.f, b)) + .5f), a);
+	}
+
+	static void stats(const Pixel * dst, const Pixel * src, int width, RenderStats * stats) { visibleStatsRow64(dst, src, width, stats); }
+};
+
+struct Linear : Encoded
+{
+	const LinearLight & light;
+
+	Linear() : light(linearLight()) {}
+
+	float load(int v) const          { return light.decode[v]; }
+	Pixel store(float r, float g, float b, int a) const
+	{
+		return rgba(light.encode[encodeIndex(r)], light.encode[encodeIndex(g)], light.encode[encodeIndex(b)], a);
+	}
+};
+
+//the source and K modifier channels times a 3x(3+K) matrix, summed in column order like multiplyRow;
+//missing modifiers read the source with their weights zeroed, so the loop has no branch on them
+template<class Format, int K>
+static void wideRowK(typename Format::Pixel * dst, const typename Format::Pixel * src, const ModifierRow * mods, int width,
+					 const float * mat, int channels, RenderStats * stats, const Format & format)
+{
+	typedef typename Format::Pixel Pixel;
+	enum { Cols = 3 + K, Slots = K > 0? K : 1 };
+
+	float         m[MATRIX_ROWS][Cols];
+	const Pixel * mod[Slots];
+	int           shift[Slots];
+
+	for(int y = 0; y < MATRIX_ROWS; ++y)
+	{
+		for(int x = 0; x < Cols; ++x)
+		{
+			m[y][x] = mat[y*WIDE_COLS + x];
+		}
+	}
+
+	for(int k = 0; k < K; ++k)
+	{
+		mod[k]   = (const Pixel *) mods[k].pixels;
+		shift[k] = Format::shift(mods[k].channel);
+
+		if(mod[k] == nullptr)
+		{
+			mod[k] = src;
+			for(int y = 0; y < MATRIX_ROWS; ++y) m[y][3+k] = 0;
+		}
+	}
+
+	const Pixel keep = Format::keep(channels);
+	uint32_t cr = 0, cg = 0, cb = 0;
+
+	for(int x = 0; x < width; ++x)
+	{
+		const Pixel pixel = src[x];
+
+		float c[Cols];
+		c[0] = format.load((pixel >> Format::shift(0)) & Format::Mask);
+		c[1] = format.load((pixel >> Format::shift(1)) & Format::Mask);
+		c[2] = format.load((pixel >> Format::shift(2)) & Format::Mask);
+
+		for(int k = 0; k < K; ++k)
+		{
+			c[3+k] = format.load((mod[k][x] >> shift[k]) & Format::Mask);
+		}
+
+		float R = 0, G = 0, B = 0;
+
+		for(int i = 0; i < Cols; ++i)
+		{
+			R += c[i] * m[0][i];
+			G += c[i] * m[1][i];
+			B += c[i] * m[2][i];
+		}
+
+		const uint32_t visible = Format::alpha(pixel) != 0;
+
+		cr += visible & Format::clamped(R);
+		cg += visible & Format::clamped(G);
+		cb += visible & Format::clamped(B);
+
+		const Pixel out = format.store(R, G, B, Format::alpha(pixel));
+		dst[x] = visible? (out & ~keep) | (dst[x] & keep) : dst[x];
+	}
+
+	if(stats)
+	{
+		addClamps(stats, channels & 0x01? cr : 0, channels & 0x02? cg : 0, channels & 0x04? cb : 0);
+		Format::stats(dst, src, width, stats);
+	}
+}
+
+template<class Format>
+static void wideRowAny(typename Format::Pixel * dst, const typename Format::Pixel * src, const ModifierRow * mods, int count, int width,
+					   const float * mat, int channels, RenderStats * stats, const Format & format = Format())
+{
+	switch(count)
+	{
+	case 0:  wideRowK<Format, 0>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 1:  wideRowK<Format, 1>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 2:  wideRowK<Format, 2>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 3:  wideRowK<Format, 3>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 4:  wideRowK<Format, 4>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 5:  wideRowK<Format, 5>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 6:  wideRowK<Format, 6>(dst, src, mods, width, mat, channels, stats, format); break;
+	case 7:  wideRowK<Format, 7>(dst, src, mods, width, mat, channels, stats, format); break;
+	default: wideRowK<Format, 8>(dst, src, mods, width, mat, channels, stats, format); break;
+	}
+}
+
+void wideRow(uint32_t * dst, const uint32_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels, RenderStats * stats)
+{
+	wideRowAny<Encoded>(dst, src, mods, count, width, mat, channels, stats);
+}
+
+void wideRow64(uint64_t * dst, const uint64_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels, RenderStats * stats)
+{
+	wideRowAny<Deep>(dst, src, mods, count, width, mat, channels, stats);
+}
+
+void wideRowLinear(uint32_t * dst, const uint32_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels, RenderStats * stats)
+{
+	wideRowAny<Linear>(dst, src, mods, count, width, mat, channels, stats);
+}
+
+}
@@ -0,0 +1,200 @@
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+#include <cstdint>
+#include "vector3.h"
+#include "quaternion.h"
+
+#define MATRIX_ROWS 3
+#define MATRIX_COLS 5
+#define MATRIX_SIZE (MATRIX_ROWS*MATRIX_COLS)
+
+//the wide matrix is 3x(3+K) over the source and up to MODIFIER_CHANNELS channels of the loaded modifiers
+#define MODIFIER_CHANNELS 8
+#define WIDE_COLS (3 + MODIFIER_CHANNELS)
+#define WIDE_SIZE (MATRIX_ROWS*WIDE_COLS)
+
+enum RenderKind
+{
+	RenderNone,
+	RenderMatrix,
+	RenderAngles,
+	RenderPigments,
+	RenderNegate,
+	RenderHSV
+};
+
+//exact matches the original per-pixel code; fast reorders the float math and is off by at most 1;
+//preview reads a 6 bit lookup table, off by up to 4 for angles, 8 for pigments and 16 for hsv (see --validate)
+enum Quality
+{
+	QualityExact,
+	QualityFast,
+	QualityPreview
+};
+
+struct TransformParams
+{
+	RenderKind kind;
+	uint8_t matrix[MATRIX_SIZE];
+	uint8_t angles[3];
+	uint8_t pigments[6];
+	uint8_t hsv[3];
+//matrix, angles, hsv and pigments mix linear light instead of the sRGB encoded values (8 bit images only)
+	bool    linear;
+
+//modifierCount 0 keeps the 3x5 matrix over the first modifier's red and green; otherwise wide is 3x(3+modifierCount),
+//rows WIDE_COLS apart, and column 3+i reads channel modifierChannel[i] % 4 (R, G, B, A) of modifier modifierChannel[i] / 4
+	uint8_t modifierCount;
+	uint8_t modifierChannel[MODIFIER_CHANNELS];
+	uint8_t wide[WIDE_SIZE];
+
+	int matrixCols() const
+	{
+		return modifierCount? 3 + modifierCount : MATRIX_COLS;
+	}
+
+//the entries the current kind reads, as edited by the sweep and comparison dialogs
+	int parameterCount() const
+	{
+		switch(kind)
+		{
+		case RenderAngles:   return sizeof(angles);
+		case RenderPigments: return sizeof(pigments);
+		case RenderHSV:      return sizeof(hsv);
+		default:             return MATRIX_ROWS * matrixCols();
+		}
+	}
+
+	uint8_t * parameter(int index)
+	{
+		switch(kind)
+		{
+		case RenderAngles:   return angles + index;
+		case RenderPigments: return pigments + index;
+		case RenderHSV:      return hsv + index;
+		default:             return modifierCount? wide + index / matrixCols() * WIDE_COLS + index % matrixCols() : matrix + index;
+		}
+	}
+};
+
+//histograms of the visible (non-transparent) pixels of a render, gathered by the row kernels
+struct RenderStats
+{
+	enum { Red, Green, Blue, Luma, Channels };
+
+	uint32_t histogram[Channels][256];
+	uint32_t clamped[3];
+	uint32_t pixels;
+
+	void clear();
+	void merge(const RenderStats & it);
+
+	void add(uint32_t pixel);
+	void clamp(bool r, bool g, bool b)
+	{
+		clamped[Red]   += r;
+		clamped[Green] += g;
+		clamped[Blue]  += b;
+	}
+
+	int    minimum(int channel) const;
+	int    maximum(int channel) const;
+	double mean(int channel) const;
+};
+
+//row kernels, pixels are 0xAARRGGBB words laid out like QRgb
+namespace ColorTransform
+{
+	inline int alpha(uint32_t p) { return p >> 24; }
+	inline int red  (uint32_t p) { return (p >> 16) & 0xFF; }
+	inline int green(uint32_t p) { return (p >>  8) & 0xFF; }
+	inline int blue (uint32_t p) { return p & 0xFF; }
+
+	inline uint32_t rgba(int r, int g, int b, int a)
+	{
+		return ((a & 0xFF) << 24) | ((r & 0xFF) << 16) | ((g & 0xFF) << 8) | (b & 0xFF);
+	}
+
+	void       prepareMatrix(float * mat, const uint8_t * matrix);
+	Quaternion prepareAngles(const uint8_t * angles);
+//hsv[0] shifts hue in 1/256 turns, hsv[1] and hsv[2] scale saturation and value with 128 as 1.0
+	void       prepareHSV(float * mat, const uint8_t * hsv);
+
+//stats may be null, otherwise every written pixel and clamped channel is counted
+	void statsRow (const uint32_t * src, int width, RenderStats * stats);
+	void negateRow(uint32_t * dst, const uint32_t * src, int width, RenderStats * stats = nullptr);
+//channels is a mask of the output channels to write, bit 0 being red; only those count clamps
+	void matrixRow(uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const float * mat, int channels = 0x07, RenderStats * stats = nullptr);
+	void anglesRow(uint32_t * dst, const uint32_t * src, int width, const Quaternion & q, RenderStats * stats = nullptr);
+//mat is the 3x3 from prepareHSV; the loop is branch free so it vectorizes, stats are gathered after it
+	void hsvRow   (uint32_t * dst, const uint32_t * src, int width, const float * mat, RenderStats * stats = nullptr);
+
+//pigments run in two stages, the swap stage only depends on pigments[3..5]
+	void swapRow(Vector3 * dst, const uint32_t * src, int width, const uint8_t * pigments);
+	void tintRow(uint32_t * dst, const uint32_t * src, const Vector3 * swapped, int width, const uint8_t * pigments, RenderStats * stats = nullptr);
+
+//fast tier: rotation as a 3x3 matrix without the length round trip, pigments with both stages fused and no branches
+	void anglesRowFast  (uint32_t * dst, const uint32_t * src, int width, const Quaternion & q, RenderStats * stats = nullptr);
+	void pigmentsRowFast(uint32_t * dst, const uint32_t * src, int width, const uint8_t * pigments, RenderStats * stats = nullptr);
+
+//preview tier: the exact result sampled at 64 levels per channel, looked up by the nearest level; clamps are not counted
+	enum { LutBits = 6, LutLevels = 1 << LutBits, LutSize = LutLevels*LutLevels*LutLevels };
+
+	bool lutSupported(RenderKind kind);
+	void buildLut(uint32_t * lut, const TransformParams & params);
+	void lutRow  (uint32_t * dst, const uint32_t * src, int width, const uint32_t * lut, RenderStats * stats = nullptr);
+
+//16 bit kernels, pixels are 0xAAAABBBBGGGGRRRR words laid out like QRgba64; every quality tier runs the same code
+	inline int red16  (uint64_t p) { return p & 0xFFFF; }
+	inline int green16(uint64_t p) { return (p >> 16) & 0xFFFF; }
+	inline int blue16 (uint64_t p) { return (p >> 32) & 0xFFFF; }
+	inline int alpha16(uint64_t p) { return p >> 48; }
+
+	inline uint64_t rgba64(int r, int g, int b, int a)
+	{
+		return ((uint64_t) (a & 0xFFFF) << 48) | ((uint64_t) (b & 0xFFFF) << 32) | ((uint64_t) (g & 0xFFFF) << 16) | (uint64_t) (r & 0xFFFF);
+	}
+
+//matrix, angles and hsv as one 3x5 matrix over (r, g, b, modifier r, modifier g) plus an offset in 0-255 units; false for other kinds
+	bool prepareAffine(float * mat, float * offset, const TransformParams & params);
+
+	void statsRow64   (const uint64_t * src, int width, RenderStats * stats);
+	void negateRow64  (uint64_t * dst, const uint64_t * src, int width, RenderStats * stats = nullptr);
+	void affineRow64  (uint64_t * dst, const uint64_t * src, const uint64_t * mod, int width, const float * mat, const float * offset, int channels = 0x07, RenderStats * stats = nullptr);
+	void pigmentsRow64(uint64_t * dst, const uint64_t * src, int width, const uint8_t * pigments, RenderStats * stats = nullptr);
+
+//wide matrix columns past the source: a row of the modifier image it reads, null without one (the column then counts
+//as 0), and the channel, 0-3 for R, G, B, A; pixels are uint32_t or uint64_t like the source's
+	struct ModifierRow
+	{
+		const void * pixels;
+		int          channel;
+	};
+
+//the wide matrix normalized like prepareMatrix, rows WIDE_COLS apart
+	void prepareWide(float * mat, const TransformParams & params);
+
+//count is K; the kernel is templated on it, so each width is a fully unrolled loop whose cost grows linearly with K.
+//8 bit rows truncate like matrixRow, 16 bit rows round like affineRow64, linear rows use the tables of affineRowLinear
+	void wideRow      (uint32_t * dst, const uint32_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels = 0x07, RenderStats * stats = nullptr);
+	void wideRow64    (uint64_t * dst, const uint64_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels = 0x07, RenderStats * stats = nullptr);
+	void wideRowLinear(uint32_t * dst, const uint32_t * src, const ModifierRow * mods, int count, int width, const float * mat, int channels = 0x07, RenderStats * stats = nullptr);
+
+//linear light: channels are decoded through a 256 entry table, and encoded back through one with EncodeSteps entries per 0-255 step
+	enum { EncodeSteps = 16 };
+
+	struct LinearLight
+	{
+		float   decode[256];
+		uint8_t encode[255*EncodeSteps + 1];
+	};
+
+	const LinearLight & linearLight();
+
+//prepareAffine's matrix and the fused pigments on linear light, for every tier; a 64 level table is too coarse
+//once the curves steepen the error near black, so there is no preview table
+	void affineRowLinear  (uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const float * mat, const float * offset, int channels = 0x07, RenderStats * stats = nullptr);
+	void pigmentsRowLinear(uint32_t * dst, const uint32_t * src, int width, const uint8_t * pigments, RenderStats * stats = nullptr);
+}
+
+#endif // COLORTRANSFORM_H
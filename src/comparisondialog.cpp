@@ -0,0 +1,144 @@
+#include "comparisondialog.h"
+#include "ui_comparisondialog.h"
+#include "mainwindow.h"
+#include "imagetransform.h"
+#include "scheduler.h"
+#include <QtConcurrent>
+#include <QMessageBox>
+#include <QPushButton>
+#include <functional>
+
+ComparisonDialog::ComparisonDialog(MainWindow * window, QWidget *parent) :
+QDialog(parent),
+window(window),
+memory(MemoryAccountant::CategoryRenders),
+ui(new Ui::ComparisonDialog)
+{
+	ui->setupUi(this);
+
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Render"));
+	ui->transformBox->setCurrentIndex(window->renderKind == RenderAngles? 1 : window->renderKind == RenderMatrix? 0 : window->renderKind == RenderHSV? 3 : 2);
+	updateRanges();
+
+	connect(ui->transformBox, static_cast<void (QComboBox::*)(int)>(&QComboBox::currentIndexChanged), this, [this](int) { updateRanges(); });
+	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &ComparisonDialog::start);
+	connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &ComparisonDialog::reject);
+	connect(ui->grid, &ComparisonGrid::cellClicked, this, &ComparisonDialog::adopt);
+
+	connect(&watcher, &QFutureWatcher<QImage>::resultReadyAt, this, [this](int index)
+	{
+		ui->grid->setCell(index, watcher.resultAt(index));
+	});
+}
+
+ComparisonDialog::~ComparisonDialog()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	delete ui;
+}
+
+RenderKind ComparisonDialog::kind() const
+{
+	switch(ui->transformBox->currentIndex())
+	{
+	case 0:  return RenderMatrix;
+	case 1:  return RenderAngles;
+	case 3:  return RenderHSV;
+	default: return RenderPigments;
+	}
+}
+
+void ComparisonDialog::updateRanges()
+{
+	int count = window->params(kind()).parameterCount();
+	ui->rowIndexBox->setMaximum(count-1);
+	ui->columnIndexBox->setMaximum(count-1);
+}
+
+static int interpolate(int from, int to, int i, int count)
+{
+	return count > 1? qRound(from + (to - from) * (double) i / (count-1)) : from;
+}
+
+void ComparisonDialog::start()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+
+	const int rows    = ui->rowsBox->value();
+	const int columns = ui->columnsBox->value();
+
+	ui->grid->setGrid(rows, columns);
+	memory.set(0);
+
+	if(window->original.isNull())
+	{
+		return;
+	}
+
+//each cell only costs its own displayed pixels, as do the scaled inputs
+	const QSize  scaled = window->original.size().scaled(ui->grid->cellSize(), Qt::KeepAspectRatio);
+	const qint64 images = rows * columns + 1 + window->modifierList().size();
+
+	if(!window->reserveMemory(memory, images * scaled.width() * scaled.height() * 4))
+	{
+		QMessageBox::information(this, windowTitle(), tr("The grid does not fit the memory budget."));
+		return;
+	}
+
+	original = window->original
+		.scaled(ui->grid->cellSize(), Qt::KeepAspectRatio, Qt::SmoothTransformation)
+		.convertToFormat(QImage::Format_ARGB32);
+
+	modifiers.clear();
+
+	for(const QImage & modifier : window->modifierList())
+	{
+		modifiers << (modifier.isNull()? QImage() : modifier
+			.scaled(original.size(), Qt::IgnoreAspectRatio, Qt::SmoothTransformation)
+			.convertToFormat(QImage::Format_ARGB32));
+	}
+
+	const TransformParams base = window->params(kind());
+
+	cells.clear();
+	cells.reserve(rows * columns);
+
+	for(int y = 0; y < rows; ++y)
+	{
+		for(int x = 0; x < columns; ++x)
+		{
+			TransformParams params = base;
+			*params.parameter(ui->rowIndexBox->value())    = interpolate(ui->rowFromBox->value(), ui->rowToBox->value(), y, rows);
+			*params.parameter(ui->columnIndexBox->value()) = interpolate(ui->columnFromBox->value(), ui->columnToBox->value(), x, columns);
+			cells.push_back(params);
+		}
+	}
+
+//queued at the pool priority of bulk work, and rendered in that class
+	std::function<QImage (const TransformParams &)> render = [this](const TransformParams & params)
+	{
+		Scheduler::Scope scope(Scheduler::PriorityBulk);
+		return ImageTransform::render(original, modifiers, params, nullptr, nullptr, 1);
+	};
+
+	watcher.setFuture(QtConcurrent::mapped(cells, render));
+}
+
+void ComparisonDialog::adopt(int index)
+{
+	if(index < 0 || index >= cells.size())
+	{
+		return;
+	}
+
+	window->adoptParams(cells[index]);
+}
+
+void ComparisonDialog::reject()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	QDialog::reject();
+}
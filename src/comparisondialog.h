@@ -0,0 +1,48 @@
+#ifndef COMPARISONDIALOG_H
+#define COMPARISONDIALOG_H
+#include "colortransform.h"
+#include "memoryaccountant.h"
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QVector>
+
+class MainWindow;
+
+namespace Ui {
+class ComparisonDialog;
+}
+
+class ComparisonDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit ComparisonDialog(MainWindow * window, QWidget *parent = 0);
+	~ComparisonDialog();
+
+	void start();
+	void adopt(int index);
+	void updateRanges();
+
+	void reject() Q_DECL_OVERRIDE;
+
+private:
+	RenderKind kind() const;
+
+	MainWindow * window;
+
+//downscaled once per start, every cell renders from these
+	QImage          original;
+	QVector<QImage> modifiers;
+
+	QVector<TransformParams> cells;
+	QFutureWatcher<QImage> watcher;
+
+//the inputs above and every cell, reserved before they are made
+	MemoryAccountant::Account memory;
+
+	Ui::ComparisonDialog *ui;
+};
+
+#endif // COMPARISONDIALOG_H
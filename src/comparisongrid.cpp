@@ -0,0 +1,107 @@
+#include "comparisongrid.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QMouseEvent>
+#include <algorithm>
+
+static const int cellSpacing = 2;
+
+ComparisonGrid::ComparisonGrid(QWidget *parent) : QWidget(parent),
+	rows(0),
+	columns(0),
+	selected(-1)
+{
+}
+
+void ComparisonGrid::setGrid(int rows, int columns)
+{
+	this->rows    = rows;
+	this->columns = columns;
+	selected = -1;
+
+	cells.clear();
+	cells.resize(rows * columns);
+	update();
+}
+
+void ComparisonGrid::setCell(int index, const QImage & image)
+{
+	if(index < 0 || index >= cells.size())
+	{
+		return;
+	}
+
+	cells[index] = image;
+	update(cellRect(index));
+}
+
+QSize ComparisonGrid::cellSize() const
+{
+	if(rows <= 0 || columns <= 0)
+	{
+		return QSize();
+	}
+
+	return QSize(std::max(1, width () / columns - cellSpacing),
+				 std::max(1, height() / rows    - cellSpacing));
+}
+
+QRect ComparisonGrid::cellRect(int index) const
+{
+	QSize size = cellSize();
+	int x = index % columns;
+	int y = index / columns;
+
+	return QRect(x * (size.width() + cellSpacing), y * (size.height() + cellSpacing), size.width(), size.height());
+}
+
+void ComparisonGrid::paintEvent(QPaintEvent * event)
+{
+	QPainter painter;
+	painter.begin(this);
+
+	painter.fillRect(event->rect(), palette().dark());
+
+	for(int i = 0; i < cells.size(); ++i)
+	{
+		QRect rect = cellRect(i);
+
+		if(!rect.intersects(event->rect()))
+		{
+			continue;
+		}
+
+		painter.fillRect(rect, Qt::gray);
+
+		if(!cells[i].isNull())
+		{
+			QSize size = cells[i].size().scaled(rect.size(), Qt::KeepAspectRatio);
+			QRect target(rect.topLeft() + QPoint((rect.width() - size.width())/2, (rect.height() - size.height())/2), size);
+			painter.drawImage(target, cells[i]);
+		}
+
+		if(i == selected)
+		{
+			painter.setPen(QPen(palette().highlight(), 2));
+			painter.drawRect(rect.adjusted(1, 1, -1, -1));
+		}
+	}
+
+	painter.end();
+}
+
+void ComparisonGrid::mousePressEvent(QMouseEvent * event)
+{
+	for(int i = 0; i < cells.size(); ++i)
+	{
+		if(cellRect(i).contains(event->pos()))
+		{
+			selected = i;
+			update();
+			emit cellClicked(i);
+			return;
+		}
+	}
+
+	super::mousePressEvent(event);
+}
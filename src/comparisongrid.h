@@ -0,0 +1,35 @@
+#ifndef COMPARISONGRID_H
+#define COMPARISONGRID_H
+
+#include <QWidget>
+#include <QImage>
+#include <QVector>
+
+class ComparisonGrid : public QWidget
+{
+typedef QWidget super;
+	Q_OBJECT
+public:
+	explicit ComparisonGrid(QWidget *parent = 0);
+
+	void  setGrid(int rows, int columns);
+	void  setCell(int index, const QImage & image);
+	QSize cellSize() const;
+
+signals:
+	void cellClicked(int index);
+
+protected:
+	void paintEvent				(QPaintEvent * event)	Q_DECL_OVERRIDE;
+	void mousePressEvent		(QMouseEvent * event)	Q_DECL_OVERRIDE;
+
+private:
+	QRect cellRect(int index) const;
+
+	int rows;
+	int columns;
+	int selected;
+	QVector<QImage> cells;
+};
+
+#endif // COMPARISONGRID_H
@@ -0,0 +1,350 @@
+#include "examplefit.h"
+#include "imagetransform.h"
+#include <QtConcurrent>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+namespace ExampleFit
+{
+
+using namespace ColorTransform;
+
+double Result::error() const
+{
+	return std::sqrt((rms[0]*rms[0] + rms[1]*rms[1] + rms[2]*rms[2]) / 3);
+}
+
+static QImage sample(const QImage & image, int step)
+{
+	if(step <= 1 || image.isNull())
+	{
+		return image;
+	}
+
+	QImage out((image.width() + step-1) / step, (image.height() + step-1) / step, image.format());
+
+	for(int y = 0; y < out.height(); ++y)
+	{
+		const uint32_t * src = (const uint32_t *) image.constScanLine(y * step);
+		uint32_t * dst = (uint32_t *) out.scanLine(y);
+
+		for(int x = 0; x < out.width(); ++x)
+		{
+			dst[x] = src[x * step];
+		}
+	}
+
+	return out;
+}
+
+void residual(const QImage & render, const QImage & target, double * rms, int threads)
+{
+	struct Sum
+	{
+		double   squares[3];
+		uint64_t pixels;
+	};
+
+	const int bands = ImageTransform::bandCount(render.height(), threads);
+	std::vector<Sum> partial(bands, Sum{{0, 0, 0}, 0});
+
+	ImageTransform::forEachBand(render.height(), bands, [&](int begin, int end, int band)
+	{
+		Sum & sum = partial[band];
+
+		for(int y = begin; y < end; ++y)
+		{
+			const uint32_t * a = (const uint32_t *) render.constScanLine(y);
+			const uint32_t * b = (const uint32_t *) target.constScanLine(y);
+
+			for(int x = 0; x < render.width(); ++x)
+			{
+				if(alpha(a[x]) == 0)
+				{
+					continue;
+				}
+
+				const int dr = red  (a[x]) - red  (b[x]);
+				const int dg = green(a[x]) - green(b[x]);
+				const int db = blue (a[x]) - blue (b[x]);
+
+				sum.squares[0] += dr*dr;
+				sum.squares[1] += dg*dg;
+				sum.squares[2] += db*db;
+				++sum.pixels;
+			}
+		}
+	});
+
+	Sum total{{0, 0, 0}, 0};
+	for(const Sum & it : partial)
+	{
+		for(int c = 0; c < 3; ++c)
+		{
+			total.squares[c] += it.squares[c];
+		}
+		total.pixels += it.pixels;
+	}
+
+	for(int c = 0; c < 3; ++c)
+	{
+		rms[c] = total.pixels? std::sqrt(total.squares[c] / total.pixels) : 0;
+	}
+}
+
+//normal equations of the 3x5 matrix, one set of right hand sides per output channel
+struct Normal
+{
+	double ata[MATRIX_COLS][MATRIX_COLS];
+	double aty[MATRIX_ROWS][MATRIX_COLS];
+
+	void clear() { memset(this, 0, sizeof(*this)); }
+
+	void merge(const Normal & it)
+	{
+		for(int i = 0; i < MATRIX_COLS; ++i)
+		{
+			for(int j = 0; j < MATRIX_COLS; ++j)
+				ata[i][j] += it.ata[i][j];
+			for(int c = 0; c < MATRIX_ROWS; ++c)
+				aty[c][i] += it.aty[c][i];
+		}
+	}
+};
+
+//gaussian elimination with partial pivoting over the free unknowns, fixed ones stay 0
+static void solve(const Normal & normal, int channel, const bool * free, double * w)
+{
+	int index[MATRIX_COLS];
+	int n = 0;
+
+	for(int i = 0; i < MATRIX_COLS; ++i)
+	{
+		w[i] = 0;
+		if(free[i]) index[n++] = i;
+	}
+
+	double a[MATRIX_COLS][MATRIX_COLS+1];
+	double trace = 0;
+
+	for(int i = 0; i < n; ++i)
+	{
+		trace += normal.ata[index[i]][index[i]];
+	}
+
+//a small ridge keeps the system solvable when a column is all zero, e.g. without a modifier
+	const double ridge = std::max(1e-9, trace * 1e-12);
+
+	for(int i = 0; i < n; ++i)
+	{
+		for(int j = 0; j < n; ++j)
+		{
+			a[i][j] = normal.ata[index[i]][index[j]] + (i == j? ridge : 0);
+		}
+		a[i][n] = normal.aty[channel][index[i]];
+	}
+
+	for(int col = 0; col < n; ++col)
+	{
+		int pivot = col;
+		for(int row = col+1; row < n; ++row)
+		{
+			if(std::fabs(a[row][col]) > std::fabs(a[pivot][col])) pivot = row;
+		}
+
+		for(int j = 0; j <= n; ++j)
+		{
+			std::swap(a[col][j], a[pivot][j]);
+		}
+
+		for(int row = col+1; row < n; ++row)
+		{
+			const double f = a[row][col] / a[col][col];
+			for(int j = col; j <= n; ++j)
+			{
+				a[row][j] -= f * a[col][j];
+			}
+		}
+	}
+
+	for(int row = n-1; row >= 0; --row)
+	{
+		double v = a[row][n];
+		for(int j = row+1; j < n; ++j)
+		{
+			v -= a[row][j] * w[index[j]];
+		}
+		w[index[row]] = v / a[row][row];
+	}
+}
+
+Result fitMatrix(const QImage & original, const QImage & modifier, const QImage & target, const TransformParams & start, int step)
+{
+	const QImage src = sample(original, step);
+	const QImage dst = sample(target, step);
+	const QImage mod = modifier.size() == original.size()? sample(modifier, step) : QImage();
+
+	const int bands = ImageTransform::bandCount(src.height());
+	std::vector<Normal> partial(bands);
+
+//in linear light the matrix mixes decoded values, and the encode table rounds instead of truncating
+	const LinearLight & light = linearLight();
+	const bool linear = start.linear;
+	auto channel = [&light, linear](int v) { return linear? (double) light.decode[v] : (double) v; };
+	const double aim = linear? 0 : .5;
+
+	ImageTransform::forEachBand(src.height(), bands, [&](int begin, int end, int band)
+	{
+		Normal & normal = partial[band];
+		normal.clear();
+
+		for(int y = begin; y < end; ++y)
+		{
+			const uint32_t * s = (const uint32_t *) src.constScanLine(y);
+			const uint32_t * t = (const uint32_t *) dst.constScanLine(y);
+			const uint32_t * m = mod.isNull()? nullptr : (const uint32_t *) mod.constScanLine(y);
+
+			for(int x = 0; x < src.width(); ++x)
+			{
+				if(alpha(s[x]) == 0)
+				{
+					continue;
+				}
+
+				const double c[MATRIX_COLS] = { channel(red(s[x])), channel(green(s[x])), channel(blue(s[x])),
+												m? channel(red(m[x])) : 0., m? channel(green(m[x])) : 0. };
+//the gamma kernel truncates, so aim for the middle of the target value
+				const double v[MATRIX_ROWS] = { channel(red(t[x])) + aim, channel(green(t[x])) + aim, channel(blue(t[x])) + aim };
+
+				for(int i = 0; i < MATRIX_COLS; ++i)
+				{
+					for(int j = i; j < MATRIX_COLS; ++j)
+						normal.ata[i][j] += c[i] * c[j];
+					for(int k = 0; k < MATRIX_ROWS; ++k)
+						normal.aty[k][i] += c[i] * v[k];
+				}
+			}
+		}
+	});
+
+	Normal normal;
+	normal.clear();
+	for(const Normal & it : partial)
+	{
+		normal.merge(it);
+	}
+
+	for(int i = 0; i < MATRIX_COLS; ++i)
+	{
+		for(int j = 0; j < i; ++j)
+		{
+			normal.ata[i][j] = normal.ata[j][i];
+		}
+	}
+
+	Result result;
+	result.params = start;
+	result.params.kind = RenderMatrix;
+
+//the fit solves the classic 3x5 over the first modifier's red and green, a wide start is replaced by it
+	result.params.modifierCount = 0;
+
+	for(int row = 0; row < MATRIX_ROWS; ++row)
+	{
+//weights are bytes, so negative ones are pinned to 0 and the rest solved again
+		bool free[MATRIX_COLS] = { true, true, true, true, true };
+		double w[MATRIX_COLS];
+
+		for(int pass = 0; pass < MATRIX_COLS; ++pass)
+		{
+			solve(normal, row, free, w);
+
+			int worst = -1;
+			for(int i = 0; i < MATRIX_COLS; ++i)
+			{
+				if(free[i] && w[i] < 0 && (worst < 0 || w[i] < w[worst])) worst = i;
+			}
+
+			if(worst < 0) break;
+			free[worst] = false;
+		}
+
+//prepareMatrix normalizes rows that sum past 1, so gains above 1 are out of reach
+		double sum = 0;
+		for(int i = 0; i < MATRIX_COLS; ++i)
+		{
+			w[i] = std::max(0., w[i]);
+			sum += w[i];
+		}
+
+		for(int i = 0; i < MATRIX_COLS; ++i)
+		{
+			const double v = sum > 1? w[i] / sum : w[i];
+			result.params.matrix[row*MATRIX_COLS + i] = std::max(0, std::min(255, (int) std::lround(v * 255)));
+		}
+	}
+
+	residual(ImageTransform::render(original, modifier, result.params), target, result.rms);
+	return result;
+}
+
+Result fitPigments(const QImage & original, const QImage & target, const TransformParams & start, int step)
+{
+	const QImage src = sample(original, step);
+	const QImage dst = sample(target, step);
+
+	std::function<double (const TransformParams &)> cost = [&](const TransformParams & params)
+	{
+		double rms[3];
+		residual(ImageTransform::render(src, QImage(), params, nullptr, nullptr, 1), dst, rms, 1);
+		return rms[0]*rms[0] + rms[1]*rms[1] + rms[2]*rms[2];
+	};
+
+	TransformParams best = start;
+	best.kind = RenderPigments;
+	double bestCost = cost(best);
+
+//pattern search: try every pigment one step up and down in parallel, move to the best, shrink the step when stuck
+	for(int size = 32, iterations = 0; size >= 1 && iterations < 512; ++iterations)
+	{
+		QVector<TransformParams> candidates;
+
+		for(int i = 0; i < (int) sizeof(best.pigments); ++i)
+		{
+			for(int sign : { -1, 1 })
+			{
+				TransformParams candidate = best;
+				candidate.pigments[i] = std::max(0, std::min(255, best.pigments[i] + sign * size));
+
+				if(candidate.pigments[i] != best.pigments[i])
+				{
+					candidates.push_back(candidate);
+				}
+			}
+		}
+
+		const QVector<double> costs = QtConcurrent::blockingMapped<QVector<double> >(candidates, cost);
+		const int pick = std::min_element(costs.begin(), costs.end()) - costs.begin();
+
+		if(pick < costs.size() && costs[pick] < bestCost)
+		{
+			best = candidates[pick];
+			bestCost = costs[pick];
+		}
+		else
+		{
+			size /= 2;
+		}
+	}
+
+	Result result;
+	result.params = best;
+	residual(ImageTransform::render(original, QImage(), best), target, result.rms);
+	return result;
+}
+
+}
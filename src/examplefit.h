@@ -0,0 +1,25 @@
+#ifndef EXAMPLEFIT_H
+#define EXAMPLEFIT_H
+#include <QImage>
+#include "colortransform.h"
+
+//finds the parameters that turn original (+modifier) into a target of the same size
+namespace ExampleFit
+{
+	struct Result
+	{
+		TransformParams params;
+//root mean square difference per channel on the 0-255 scale, over the visible pixels of the whole image
+		double rms[3];
+
+		double error() const;
+	};
+
+//step uses every step-th pixel of every step-th row for fitting
+	Result fitMatrix  (const QImage & original, const QImage & modifier, const QImage & target, const TransformParams & start, int step = 1);
+	Result fitPigments(const QImage & original, const QImage & target, const TransformParams & start, int step = 4);
+
+	void residual(const QImage & render, const QImage & target, double * rms, int threads = 0);
+}
+
+#endif // EXAMPLEFIT_H
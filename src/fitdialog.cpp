@@ -0,0 +1,123 @@
+#include "fitdialog.h"
+#include "ui_fitdialog.h"
+#include "mainwindow.h"
+#include <QtConcurrent>
+#include <QFileDialog>
+#include <QImageReader>
+#include <QMessageBox>
+#include <QPushButton>
+
+FitDialog::FitDialog(MainWindow * window, QWidget *parent) :
+QDialog(parent),
+window(window),
+memory(MemoryAccountant::CategoryScratch),
+ui(new Ui::FitDialog)
+{
+	ui->setupUi(this);
+
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Fit"));
+	ui->transformBox->setCurrentIndex(window->renderKind == RenderPigments? 1 : 0);
+
+	connect(ui->browseButton, &QToolButton::clicked, this, &FitDialog::browse);
+	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &FitDialog::start);
+	connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &FitDialog::reject);
+	connect(&watcher, &QFutureWatcher<ExampleFit::Result>::finished, this, &FitDialog::finished);
+}
+
+FitDialog::~FitDialog()
+{
+	watcher.waitForFinished();
+	delete ui;
+}
+
+RenderKind FitDialog::kind() const
+{
+	return ui->transformBox->currentIndex() == 1? RenderPigments : RenderMatrix;
+}
+
+ExampleFit::Result FitDialog::result() const
+{
+	return watcher.result();
+}
+
+void FitDialog::browse()
+{
+	QString name = QFileDialog::getOpenFileName(this, tr("Target Image"), ui->targetEdit->text());
+
+	if(!name.isEmpty())
+	{
+		ui->targetEdit->setText(name);
+	}
+}
+
+void FitDialog::start()
+{
+	if(watcher.isRunning())
+	{
+		return;
+	}
+
+	const int    step   = ui->stepBox->value();
+	const qint64 frame  = (qint64) window->original.width() * window->original.height() * 4;
+	const int    copies = window->modifier.isNull()? 3 : 4;
+
+	memory.set(0);
+
+	if(!window->reserveMemory(memory, frame * copies + (step > 1? frame * copies / ((qint64) step * step) : 0)))
+	{
+		QMessageBox::information(this, windowTitle(), tr("The fit needs more than the memory budget."));
+		return;
+	}
+
+	QImageReader reader(ui->targetEdit->text());
+	reader.setAutoTransform(true);
+	target = reader.read();
+
+	if(target.isNull())
+	{
+		memory.set(0);
+		QMessageBox::information(this, windowTitle(), tr("Cannot load the target: %1").arg(reader.errorString()));
+		return;
+	}
+
+	if(target.size() != window->original.size())
+	{
+		memory.set(0);
+		QMessageBox::information(this, windowTitle(), tr("The target must have the same dimensions as the base image."));
+		return;
+	}
+
+	target   = target.convertToFormat(QImage::Format_ARGB32);
+//the fit works on 8 bit pixels, the parameters it finds apply to 16 bit images all the same
+	original = window->original.convertToFormat(QImage::Format_ARGB32);
+	modifier = window->modifier.isNull()? QImage() : window->modifier.convertToFormat(QImage::Format_ARGB32);
+
+	const TransformParams start = window->params(kind());
+
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+	ui->progressBar->setRange(0, 0);
+
+	if(start.kind == RenderMatrix)
+	{
+		watcher.setFuture(QtConcurrent::run([this, start, step]() { return ExampleFit::fitMatrix(original, modifier, target, start, step); }));
+	}
+	else
+	{
+		watcher.setFuture(QtConcurrent::run([this, start, step]() { return ExampleFit::fitPigments(original, target, start, step); }));
+	}
+}
+
+void FitDialog::finished()
+{
+	ui->progressBar->setRange(0, 1);
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+	memory.set(0);
+	accept();
+}
+
+//the search cannot be interrupted, closing waits for it
+void FitDialog::reject()
+{
+	watcher.waitForFinished();
+	QDialog::reject();
+}
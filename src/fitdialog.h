@@ -0,0 +1,48 @@
+#ifndef FITDIALOG_H
+#define FITDIALOG_H
+#include "examplefit.h"
+#include "memoryaccountant.h"
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QImage>
+
+class MainWindow;
+
+namespace Ui {
+class FitDialog;
+}
+
+class FitDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit FitDialog(MainWindow * window, QWidget *parent = 0);
+	~FitDialog();
+
+	void browse();
+	void start();
+	void finished();
+
+	void reject() Q_DECL_OVERRIDE;
+
+	ExampleFit::Result result() const;
+
+private:
+	RenderKind kind() const;
+
+	MainWindow * window;
+
+	QImage original;
+	QImage modifier;
+	QImage target;
+
+//the images above, the samples the fit takes of them and its final full size render
+	MemoryAccountant::Account memory;
+
+	QFutureWatcher<ExampleFit::Result> watcher;
+
+	Ui::FitDialog *ui;
+};
+
+#endif // FITDIALOG_H
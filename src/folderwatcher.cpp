@@ -0,0 +1,366 @@
+#include "folderwatcher.h"
+#include "imagetransform.h"
+#include "imagesequence.h"
+#include "memoryaccountant.h"
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QThread>
+#include <QtConcurrent>
+
+static const int   settleInterval   = 500;
+static const int   manifestInterval = 1000;
+static const char  manifestName[]   = ".colortester-manifest.json";
+
+FolderWatcher::FolderWatcher(const QString & input, const QString & output, const TransformParams & params, int jobs, QObject *parent) :
+QObject(parent),
+input(input),
+output(output),
+params(params)
+{
+	paramsHash = QCryptographicHash::hash(
+		QJsonDocument(ImageTransform::paramsToJson(params)).toJson(QJsonDocument::Compact),
+		QCryptographicHash::Sha1);
+
+	pool.setMaxThreadCount(jobs > 0? jobs : QThread::idealThreadCount());
+
+	for(const QByteArray & format : QImageReader::supportedImageFormats())
+	{
+		filters.append("*." + QString::fromLatin1(format));
+	}
+
+	debounce.setSingleShot(true);
+	debounce.setInterval(settleInterval);
+	connect(&debounce, &QTimer::timeout, this, &FolderWatcher::settle);
+
+	manifestTimer.setSingleShot(true);
+	manifestTimer.setInterval(manifestInterval);
+	connect(&manifestTimer, &QTimer::timeout, this, &FolderWatcher::saveManifest);
+
+//one watch for the folder, scan() tells the files that changed from their size and time
+	watcher.addPath(this->input.absolutePath());
+	connect(&watcher, &QFileSystemWatcher::directoryChanged, this, &FolderWatcher::changed);
+
+	loadManifest();
+}
+
+FolderWatcher::~FolderWatcher()
+{
+	pool.waitForDone();
+	saveManifest();
+}
+
+bool FolderWatcher::idle() const
+{
+	return pending.isEmpty() && running.isEmpty();
+}
+
+FolderWatcher::Pending FolderWatcher::stamp(const QFileInfo & info)
+{
+	return Pending{ info.size(), info.lastModified().toMSecsSinceEpoch() };
+}
+
+void FolderWatcher::scan()
+{
+	for(const QFileInfo & info : input.entryInfoList(filters, QDir::Files))
+	{
+		Pending current = stamp(info);
+		auto last = seen.constFind(info.fileName());
+
+		if(last != seen.constEnd() && last->size == current.size && last->modified == current.modified)
+		{
+			continue;
+		}
+
+		changed(info.absoluteFilePath());
+	}
+}
+
+void FolderWatcher::changed(const QString & path)
+{
+	QFileInfo info(path);
+
+	if(info.isDir())
+	{
+		scan();
+		return;
+	}
+
+	if(!info.exists() || !QDir::match(filters, info.fileName()))
+	{
+		return;
+	}
+
+	pending.insert(info.fileName(), stamp(info));
+	debounce.start();
+}
+
+void FolderWatcher::settle()
+{
+	for(auto i = pending.begin(); i != pending.end(); )
+	{
+		QFileInfo info(input.filePath(i.key()));
+		Pending current = stamp(info);
+
+		if(!info.exists())
+		{
+			i = pending.erase(i);
+		}
+		else if(current.size == i->size && current.modified == i->modified)
+		{
+			const QString name = i.key();
+			i = pending.erase(i);
+			seen.insert(name, current);
+			enqueue(name);
+		}
+		else
+		{
+			*i = current;
+			++i;
+		}
+	}
+
+	if(!pending.isEmpty())
+	{
+		debounce.start();
+	}
+
+//every pending file may have vanished with nothing left running
+	if(idle())
+	{
+		emit drained();
+	}
+}
+
+void FolderWatcher::enqueue(const QString & name)
+{
+	if(running.contains(name))
+	{
+		if(!requeue.contains(name)) requeue.append(name);
+		return;
+	}
+
+	running.append(name);
+
+	QFutureWatcher<Result> * future = new QFutureWatcher<Result>(this);
+	connect(future, &QFutureWatcher<Result>::finished, this, [this, future]()
+	{
+		finished(future->result());
+		future->deleteLater();
+	});
+
+	const Entry entry = manifest.value(name);
+	future->setFuture(QtConcurrent::run(&pool, [this, name, entry]() { return process(name, entry); }));
+}
+
+FolderWatcher::Result FolderWatcher::process(const QString & name, const Entry & entry) const
+{
+	Result result;
+	result.name    = name;
+	result.written = false;
+	result.skipped = false;
+
+	QFile file(input.filePath(name));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		result.error = file.errorString();
+		return result;
+	}
+
+	const QByteArray data = file.readAll();
+	result.inputHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+
+	if(result.inputHash == entry.inputHash && paramsHash == entry.paramsHash && output.exists(name))
+	{
+		result.skipped = true;
+		return result;
+	}
+
+//every frame decoded and rendered, reserved before any of them is made
+	MemoryAccountant::Account sourceMemory(MemoryAccountant::CategorySources);
+	MemoryAccountant::Account renderMemory(MemoryAccountant::CategoryRenders);
+	const qint64 bytes = ImageSequence::decodedBytes(input.filePath(name));
+
+	if(!MemoryAccountant::reserve(sourceMemory, bytes) || !MemoryAccountant::reserve(renderMemory, bytes))
+	{
+		result.error = "does not fit the memory budget";
+		return result;
+	}
+
+	QBuffer buffer;
+	buffer.setData(data);
+	buffer.open(QIODevice::ReadOnly);
+
+	QString error;
+	const QVector<QImage> frames = ImageSequence::read(&buffer, &error);
+
+	if(frames.isEmpty())
+	{
+		result.error = error.isEmpty()? QString("cannot decode") : error;
+		return result;
+	}
+
+//the pool already runs one file per core, so each frame renders on its worker
+	QVector<QImage> renders;
+	renders.reserve(frames.size());
+	qint64 held = 0;
+
+	for(const QImage & frame : frames)
+	{
+		renders << ImageTransform::render(frame, QImage(), params, nullptr, nullptr, 1);
+		held += frame.byteCount();
+	}
+
+	sourceMemory.set(held);
+	renderMemory.set(held);
+
+	result.written = ImageSequence::write(output.filePath(name), renders, &error);
+	if(!result.written) result.error = error.isEmpty()? QString("cannot write") : error;
+
+	return result;
+}
+
+void FolderWatcher::finished(const Result & result)
+{
+	running.removeOne(result.name);
+
+	QTextStream log(stderr);
+
+	if(result.written)
+	{
+		manifest.insert(result.name, Entry{ result.inputHash, paramsHash });
+		manifestTimer.start();
+		log << "wrote " << result.name << endl;
+	}
+	else if(result.skipped)
+	{
+		log << "up to date " << result.name << endl;
+	}
+	else
+	{
+		seen.remove(result.name);
+		log << "failed " << result.name << ": " << result.error << endl;
+	}
+
+	if(requeue.removeOne(result.name))
+	{
+		enqueue(result.name);
+	}
+
+	if(idle())
+	{
+		emit drained();
+	}
+}
+
+void FolderWatcher::loadManifest()
+{
+	QFile file(output.filePath(manifestName));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		return;
+	}
+
+	const QJsonObject files = QJsonDocument::fromJson(file.readAll()).object().value("files").toObject();
+
+	for(auto i = files.begin(); i != files.end(); ++i)
+	{
+		const QJsonObject it = i.value().toObject();
+		manifest.insert(i.key(), Entry{
+			QByteArray::fromHex(it.value("input").toString().toLatin1()),
+			QByteArray::fromHex(it.value("params").toString().toLatin1()) });
+	}
+}
+
+void FolderWatcher::saveManifest()
+{
+	QJsonObject files;
+
+	for(auto i = manifest.constBegin(); i != manifest.constEnd(); ++i)
+	{
+		QJsonObject it;
+		it.insert("input",  QString::fromLatin1(i->inputHash.toHex()));
+		it.insert("params", QString::fromLatin1(i->paramsHash.toHex()));
+		files.insert(i.key(), it);
+	}
+
+	QJsonObject root;
+	root.insert("files", files);
+
+	QSaveFile file(output.filePath(manifestName));
+
+	if(file.open(QIODevice::WriteOnly))
+	{
+		file.write(QJsonDocument(root).toJson());
+		file.commit();
+	}
+}
+
+int FolderWatcher::run(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addPositionalArgument("input", "Folder to watch.");
+	parser.addOption(QCommandLineOption("watch"));
+	parser.addOption(QCommandLineOption("output", "Folder for processed copies.", "dir"));
+	parser.addOption(QCommandLineOption("params", "Parameter set saved from File > Save Parameters.", "file"));
+	parser.addOption(QCommandLineOption("jobs", "Files processed at once.", "n", "0"));
+	parser.addOption(QCommandLineOption("once", "Bring the output up to date and exit."));
+	parser.addOption(QCommandLineOption("memory-budget", "Refuse files past <MiB> of image buffers.", "MiB"));
+	parser.process(arguments);
+
+	QTextStream err(stderr);
+
+	if(parser.positionalArguments().size() != 1 || !parser.isSet("output") || !parser.isSet("params"))
+	{
+		err << "usage: ColorTester --watch <input dir> --output <dir> --params <file.json> [--jobs n] [--once] [--memory-budget MiB]" << endl;
+		return 1;
+	}
+
+	QFile file(parser.value("params"));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		err << "Cannot read " << file.fileName() << ": " << file.errorString() << endl;
+		return 1;
+	}
+
+	const TransformParams params = ImageTransform::paramsFromJson(QJsonDocument::fromJson(file.readAll()).object());
+
+	const QDir input(parser.positionalArguments().first());
+	QDir output(parser.value("output"));
+
+	if(!input.exists() || !output.mkpath(".") || input.canonicalPath() == output.canonicalPath())
+	{
+		err << "Input must be an existing folder other than the output folder." << endl;
+		return 1;
+	}
+
+	MemoryAccountant::setBudget(parser.value("memory-budget").toLongLong() * 1048576);
+
+	FolderWatcher watcher(input.path(), output.path(), params, parser.value("jobs").toInt());
+
+	if(parser.isSet("once"))
+	{
+		QObject::connect(&watcher, &FolderWatcher::drained, QCoreApplication::instance(), &QCoreApplication::quit);
+	}
+
+	watcher.scan();
+
+	if(parser.isSet("once") && watcher.idle())
+	{
+		return 0;
+	}
+
+	return QCoreApplication::exec();
+}
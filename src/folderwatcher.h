@@ -0,0 +1,87 @@
+#ifndef FOLDERWATCHER_H
+#define FOLDERWATCHER_H
+#include "colortransform.h"
+#include <QObject>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QJsonObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QTimer>
+
+//keeps processed copies of every image in a folder in sync with a saved parameter set
+//ColorTester --watch <input dir> --output <dir> --params <file.json> [--jobs n] [--once] [--memory-budget MiB]
+class FolderWatcher : public QObject
+{
+	Q_OBJECT
+
+public:
+	FolderWatcher(const QString & input, const QString & output, const TransformParams & params, int jobs, QObject *parent = 0);
+	~FolderWatcher();
+
+	void scan();
+	bool idle() const;
+
+	static int run(const QStringList & arguments);
+
+signals:
+	void drained();
+
+private:
+//what the manifest remembers about one output
+	struct Entry
+	{
+		QByteArray inputHash;
+		QByteArray paramsHash;
+	};
+
+	struct Result
+	{
+		QString    name;
+		QByteArray inputHash;
+		bool       written;
+		bool       skipped;
+		QString    error;
+	};
+
+	struct Pending
+	{
+		qint64 size;
+		qint64 modified;
+	};
+
+	static Pending stamp(const QFileInfo & info);
+
+	void changed(const QString & path);
+	void settle();
+	void enqueue(const QString & name);
+	void finished(const Result & result);
+
+	void loadManifest();
+	void saveManifest();
+
+	Result process(const QString & name, const Entry & entry) const;
+
+	QDir input;
+	QDir output;
+	TransformParams params;
+	QByteArray      paramsHash;
+
+	QFileSystemWatcher watcher;
+	QThreadPool        pool;
+
+//files still being written are only picked up once their size and time stop changing
+	QHash<QString, Pending> pending;
+	QHash<QString, Pending> seen;
+	QTimer                  debounce;
+	QStringList             filters;
+
+	QHash<QString, Entry> manifest;
+	QTimer                manifestTimer;
+	QStringList           running;
+	QStringList           requeue;
+};
+
+#endif // FOLDERWATCHER_H
@@ -0,0 +1,255 @@
+#include "framestream.h"
+#include "imagetransform.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QSemaphore>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace FrameStream
+{
+
+//two frames in flight on each side of the transform stage
+static const int slotCount = 4;
+
+//rgba bytes are 0xAABBGGRR words, swapping red and blue turns them into the kernels' 0xAARRGGBB and back
+static void swapRedBlue(uint32_t * row, int width)
+{
+	for(int x = 0; x < width; ++x)
+	{
+		const uint32_t p = row[x];
+		row[x] = (p & 0xFF00FF00u) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+	}
+}
+
+static size_t readFully(uchar * data, size_t size)
+{
+	size_t total = 0;
+
+	while(total < size)
+	{
+		size_t n = fread(data + total, 1, size - total, stdin);
+		if(n == 0) break;
+		total += n;
+	}
+
+	return total;
+}
+
+int run(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("stream"));
+	parser.addOption(QCommandLineOption("size", "Frame size.", "wxh"));
+	parser.addOption(QCommandLineOption("params", "Parameter set saved from File > Save Parameters.", "file"));
+	parser.addOption(QCommandLineOption("format", "Byte order of the frames, rgba or bgra.", "order", "rgba"));
+	parser.addOption(QCommandLineOption("modifier", "Modifier image, the size of a frame.", "image"));
+	parser.addOption(QCommandLineOption("quiet", "Only report the totals at the end."));
+	parser.process(arguments);
+
+	QTextStream err(stderr);
+
+	const QStringList size = parser.value("size").split('x');
+	const int width  = size.size() == 2? size[0].toInt() : 0;
+	const int height = size.size() == 2? size[1].toInt() : 0;
+	const QString format = parser.value("format");
+
+	if(width <= 0 || height <= 0 || !parser.isSet("params") || (format != "rgba" && format != "bgra"))
+	{
+		err << "usage: ColorTester --stream --size <w>x<h> --params <file.json> [--format rgba|bgra] [--modifier image] [--quiet]" << endl;
+		return 1;
+	}
+
+	QFile file(parser.value("params"));
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		err << "Cannot read " << file.fileName() << ": " << file.errorString() << endl;
+		return 1;
+	}
+
+	const TransformParams params = ImageTransform::paramsFromJson(QJsonDocument::fromJson(file.readAll()).object());
+
+	QImage modifier;
+
+	if(parser.isSet("modifier"))
+	{
+		QImageReader reader(parser.value("modifier"));
+		modifier = reader.read().convertToFormat(QImage::Format_ARGB32);
+
+		if(modifier.size() != QSize(width, height))
+		{
+			err << "The modifier must be " << width << "x" << height << "." << endl;
+			return 1;
+		}
+	}
+
+#ifdef Q_OS_WIN
+	_setmode(_fileno(stdin), _O_BINARY);
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+
+	const bool   swap      = format == "rgba";
+	const int    stride    = width * 4;
+	const size_t frameSize = (size_t) stride * height;
+
+	std::vector<std::vector<uchar> > slots(slotCount, std::vector<uchar>(frameSize));
+
+//free -> read -> loaded -> transform -> transformed -> write -> free, each stage walks the slots in order
+	QSemaphore freeSlots(slotCount);
+	QSemaphore loaded;
+	QSemaphore transformed;
+
+	std::atomic<qint64> end(-1);
+	std::atomic<bool>   stop(false);
+	std::atomic<qint64> readTime(0), writeTime(0);
+	bool truncated = false, failed = false;
+
+	QThreadPool io;
+	io.setMaxThreadCount(2);
+
+	QFuture<void> reader = QtConcurrent::run(&io, [&]()
+	{
+		QElapsedTimer timer;
+
+		for(qint64 i = 0;; ++i)
+		{
+			freeSlots.acquire();
+
+			timer.start();
+			const size_t n = stop? 0 : readFully(slots[i % slotCount].data(), frameSize);
+			readTime += timer.nsecsElapsed();
+
+			if(n != frameSize)
+			{
+				truncated = n != 0;
+				end = i;
+				loaded.release();
+				return;
+			}
+
+			loaded.release();
+		}
+	});
+
+	QFuture<void> writer = QtConcurrent::run(&io, [&]()
+	{
+		QElapsedTimer timer;
+
+		for(qint64 i = 0;; ++i)
+		{
+			transformed.acquire();
+
+			if(i == end)
+			{
+				return;
+			}
+
+//after a failed write keep draining so the other stages can finish
+			timer.start();
+			if(!failed && fwrite(slots[i % slotCount].data(), 1, frameSize, stdout) != frameSize)
+			{
+				failed = true;
+				stop = true;
+			}
+			writeTime += timer.nsecsElapsed();
+
+			freeSlots.release();
+		}
+	});
+
+	QElapsedTimer total, interval;
+	total.start();
+	interval.start();
+
+	qint64 transformTime = 0;
+	qint64 frames = 0, intervalFrames = 0;
+
+	for(;; ++frames)
+	{
+		loaded.acquire();
+
+		if(frames == end)
+		{
+			transformed.release();
+			break;
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+
+		uchar * bits = slots[frames % slotCount].data();
+
+//each band is swizzled, transformed and swizzled back while its rows are still in cache
+		ImageTransform::forEachBand(height, ImageTransform::bandCount(height), [&](int begin, int last, int)
+		{
+			const int rows = last - begin;
+
+			for(int y = begin; swap && y < last; ++y)
+			{
+				swapRedBlue((uint32_t *) (bits + (size_t) y * stride), width);
+			}
+
+			QImage band(bits + (size_t) begin * stride, width, rows, stride, QImage::Format_ARGB32);
+			QImage other = modifier.isNull()? QImage() : ImageTransform::region(modifier, QRect(0, begin, width, rows));
+
+			ImageTransform::apply(band, band, other, params, nullptr, nullptr, 0x07, 1);
+
+			for(int y = begin; swap && y < last; ++y)
+			{
+				swapRedBlue((uint32_t *) (bits + (size_t) y * stride), width);
+			}
+		});
+
+		transformTime += timer.nsecsElapsed();
+		transformed.release();
+		++intervalFrames;
+
+		if(!parser.isSet("quiet") && interval.elapsed() >= 1000)
+		{
+			err << "frame " << frames + 1 << ", " << QString::number(intervalFrames * 1000.0 / interval.elapsed(), 'f', 1)
+				<< " fps, " << QString::number((frames + 1) * 1000.0 / total.elapsed(), 'f', 1) << " sustained" << endl;
+			interval.restart();
+			intervalFrames = 0;
+		}
+	}
+
+	reader.waitForFinished();
+	writer.waitForFinished();
+	fflush(stdout);
+
+	const double seconds = total.elapsed() / 1000.0;
+	auto perFrame = [frames](qint64 ns) { return QString::number(frames? ns / 1e6 / frames : 0, 'f', 2); };
+
+	err << frames << " frames in " << QString::number(seconds, 'f', 2) << "s, "
+		<< QString::number(seconds > 0? frames / seconds : 0, 'f', 1) << " fps sustained; per frame read "
+		<< perFrame(readTime) << " ms, transform " << perFrame(transformTime) << " ms, write " << perFrame(writeTime) << " ms" << endl;
+
+	if(truncated)
+	{
+		err << "Input ended inside a frame, the partial frame was dropped." << endl;
+	}
+
+	if(failed)
+	{
+		err << "Writing to stdout failed." << endl;
+		return 1;
+	}
+
+	return truncated? 1 : 0;
+}
+
+}
@@ -0,0 +1,12 @@
+#ifndef FRAMESTREAM_H
+#define FRAMESTREAM_H
+#include <QStringList>
+
+//transforms raw 8 bit frames from stdin to stdout, e.g. decoder | ColorTester --stream ... | encoder
+//ColorTester --stream --size <w>x<h> --params <file.json> [--format rgba|bgra] [--modifier image] [--quiet]
+namespace FrameStream
+{
+	int run(const QStringList & arguments);
+}
+
+#endif // FRAMESTREAM_H
@@ -0,0 +1,84 @@
+#include "histogramview.h"
+#include <QPainter>
+#include <QPaintEvent>
+#include <QPainterPath>
+#include <algorithm>
+
+static const int textLines = 5;
+
+HistogramView::HistogramView(QWidget *parent) : QWidget(parent)
+{
+	stats.clear();
+}
+
+void HistogramView::setStats(const RenderStats & stats)
+{
+	this->stats = stats;
+	update();
+}
+
+QSize HistogramView::sizeHint() const
+{
+	return QSize(256, 128 + textLines * fontMetrics().height());
+}
+
+void HistogramView::paintEvent(QPaintEvent *)
+{
+static const QColor colors[RenderStats::Channels] = { Qt::red, Qt::green, Qt::blue, Qt::darkGray };
+static const char * names[RenderStats::Channels]  = { "R", "G", "B", "Luma" };
+
+	QPainter painter;
+	painter.begin(this);
+	painter.fillRect(rect(), palette().base());
+
+	const int lineHeight = fontMetrics().height();
+	QRect plot = rect().adjusted(0, 0, 0, -textLines * lineHeight);
+
+	uint32_t peak = 1;
+	for(int c = 0; c < RenderStats::Channels; ++c)
+	{
+		peak = std::max(peak, *std::max_element(stats.histogram[c], stats.histogram[c] + 256));
+	}
+
+	painter.setRenderHint(QPainter::Antialiasing);
+
+	for(int c = 0; c < RenderStats::Channels; ++c)
+	{
+		QPainterPath path;
+		for(int i = 0; i < 256; ++i)
+		{
+			QPointF p(plot.left() + plot.width() * i / 255.0,
+					  plot.bottom() - plot.height() * (double) stats.histogram[c][i] / peak);
+			if(i == 0) path.moveTo(p);
+			else       path.lineTo(p);
+		}
+
+		painter.setPen(colors[c]);
+		painter.drawPath(path);
+	}
+
+	painter.setPen(palette().text().color());
+
+	int y = plot.bottom() + lineHeight;
+	painter.drawText(0, y, tr("%1 visible pixels").arg(stats.pixels));
+
+	for(int c = 0; c < RenderStats::Channels; ++c)
+	{
+		y += lineHeight;
+
+		QString line = tr("%1: %2-%3, mean %4")
+			.arg(names[c])
+			.arg(stats.minimum(c))
+			.arg(stats.maximum(c))
+			.arg(stats.mean(c), 0, 'f', 1);
+
+		if(c < 3)
+		{
+			line += tr(", %1 clamped").arg(stats.clamped[c]);
+		}
+
+		painter.drawText(0, y, line);
+	}
+
+	painter.end();
+}
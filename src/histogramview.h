@@ -0,0 +1,24 @@
+#ifndef HISTOGRAMVIEW_H
+#define HISTOGRAMVIEW_H
+
+#include <QWidget>
+#include "colortransform.h"
+
+class HistogramView : public QWidget
+{
+	Q_OBJECT
+public:
+	explicit HistogramView(QWidget *parent = 0);
+
+	void setStats(const RenderStats & stats);
+
+	QSize sizeHint() const Q_DECL_OVERRIDE;
+
+protected:
+	void paintEvent				(QPaintEvent * event)	Q_DECL_OVERRIDE;
+
+private:
+	RenderStats stats;
+};
+
+#endif // HISTOGRAMVIEW_H
@@ -0,0 +1,62 @@
+#include "hsveditor.h"
+#include "ui_hsveditor.h"
+#include "mainwindow.h"
+#include "ui_mainwindow.h"
+
+
+HSVEditor::HSVEditor(MainWindow * window, QWidget *parent) :
+QDialog(parent),
+window(window),
+ui(new Ui::HSVEditor)
+{
+	ui->setupUi(this);
+
+	memcpy(originalHSV, window->hsv, sizeof(window->hsv));
+
+	sliders[0] = ui->horizontalSlider;
+	sliders[1] = ui->horizontalSlider_2;
+	sliders[2] = ui->horizontalSlider_3;
+
+	for(size_t i = 0; i < sliders.size(); ++i)
+	{
+		sliders[i]->setValue(window->hsv[i]);
+		connect(sliders[i], &QSlider::valueChanged, this, &HSVEditor::updateHSVDisplay);
+		connect(sliders[i], &QSlider::sliderPressed, this, [window]() { window->setDragging(true); });
+		connect(sliders[i], &QSlider::sliderReleased, this, [window]() { window->setDragging(false); });
+	}
+
+	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &HSVEditor::accepted);
+	connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &HSVEditor::rejected);
+
+	updateHSVDisplay(0);
+}
+
+HSVEditor::~HSVEditor()
+{
+	delete ui;
+}
+
+void HSVEditor::accepted()
+{
+	accept();
+}
+
+void HSVEditor::rejected()
+{
+	memcpy(window->hsv, originalHSV, sizeof(window->hsv));
+	window->applyHSV();
+	window->ui->widget->repaint();
+	reject();
+}
+
+void HSVEditor::updateHSVDisplay(int)
+{
+	for(size_t i = 0; i < sliders.size(); ++i)
+	{
+		window->hsv[i] = sliders[i]->value();
+	}
+
+	SessionRecorder::recordEdit(window->params(RenderHSV));
+	window->applyHSV();
+	window->ui->widget->repaint();
+}
@@ -0,0 +1,34 @@
+#ifndef HSVEDITOR_H
+#define HSVEDITOR_H
+
+#include <QDialog>
+#include <array>
+
+class MainWindow;
+class QSlider;
+
+namespace Ui {
+class HSVEditor;
+}
+
+class HSVEditor : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit HSVEditor(MainWindow * window, QWidget *parent = 0);
+	~HSVEditor();
+
+	void accepted();
+	void rejected();
+	void updateHSVDisplay(int);
+
+private:
+	uint8_t originalHSV[3];
+
+	MainWindow * window;
+	std::array<QSlider*, 3> sliders;
+	Ui::HSVEditor *ui;
+};
+
+#endif // HSVEDITOR_H
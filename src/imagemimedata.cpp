@@ -0,0 +1,45 @@
+#include "imagemimedata.h"
+#include <QStringList>
+
+static const char * const imageMimeType = "application/x-qt-image";
+
+ImageMimeData::ImageMimeData(const QImage & image) :
+	image(image),
+	memory(MemoryAccountant::CategoryRenders)
+{
+}
+
+ImageMimeData::ImageMimeData(const QFuture<QImage> & render, qint64 bytes) :
+	render(render),
+	memory(MemoryAccountant::CategoryRenders, bytes)
+{
+}
+
+QStringList ImageMimeData::formats() const
+{
+	return QStringList() << imageMimeType;
+}
+
+bool ImageMimeData::hasFormat(const QString & mimeType) const
+{
+	return mimeType == QLatin1String(imageMimeType);
+}
+
+//only waits for the render if another application pastes before it is done
+QVariant ImageMimeData::retrieveData(const QString & mimeType, QVariant::Type type) const
+{
+	if(mimeType != QLatin1String(imageMimeType))
+	{
+		return QMimeData::retrieveData(mimeType, type);
+	}
+
+//a default constructed future counts as canceled
+	if(image.isNull() && !render.isCanceled())
+	{
+		image  = render.result();
+		render = QFuture<QImage>();
+		memory.set(image.byteCount());
+	}
+
+	return image;
+}
@@ -0,0 +1,37 @@
+#ifndef IMAGEMIMEDATA_H
+#define IMAGEMIMEDATA_H
+#include "memoryaccountant.h"
+#include <QMimeData>
+#include <QImage>
+#include <QFuture>
+
+//clipboard data for an image that may still be rendering; nothing is encoded until a reader asks for a format,
+//the platform then encodes PNG, BMP and the like from imageData()
+class ImageMimeData : public QMimeData
+{
+	Q_OBJECT
+
+public:
+//image if it is already rendered, otherwise the render in progress and about the bytes it will take
+	explicit ImageMimeData(const QImage & image);
+	ImageMimeData(const QFuture<QImage> & render, qint64 bytes);
+
+//for pastes within the process: the image if it was given or already fetched, else the render to wait on
+	QImage          rendered() const { return image; }
+	QFuture<QImage> pending() const { return render; }
+
+	QStringList formats() const Q_DECL_OVERRIDE;
+	bool        hasFormat(const QString & mimeType) const Q_DECL_OVERRIDE;
+
+protected:
+	QVariant retrieveData(const QString & mimeType, QVariant::Type type) const Q_DECL_OVERRIDE;
+
+private:
+	mutable QImage          image;
+	mutable QFuture<QImage> render;
+
+//only the background render is counted, an image passed in is shared with the view's render
+	mutable MemoryAccountant::Account memory;
+};
+
+#endif // IMAGEMIMEDATA_H
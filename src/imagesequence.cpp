@@ -0,0 +1,214 @@
+#include "imagesequence.h"
+#include "imagetransform.h"
+#include "scheduler.h"
+#include <QImageReader>
+#include <QImageWriter>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+
+namespace ImageSequence
+{
+
+QImage::Format workingFormat(const QImage & image)
+{
+	return workingFormat(image.format());
+}
+
+QImage::Format workingFormat(QImage::Format format)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 13, 0)
+	if(format == QImage::Format_Grayscale16)
+	{
+		return QImage::Format_RGBA64;
+	}
+#endif
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+	if(format != QImage::Format_Invalid && QImage::toPixelFormat(format).bitsPerPixel() == 64)
+	{
+		return QImage::Format_RGBA64;
+	}
+#else
+	Q_UNUSED(format);
+#endif
+	return QImage::Format_ARGB32;
+}
+
+static qint64 decodedBytes(QImageReader & reader, int limit)
+{
+	const QSize size = reader.size();
+
+	if(!size.isValid())
+	{
+		return 0;
+	}
+
+	int count = std::max(1, reader.imageCount());
+
+	if(limit > 0)
+	{
+		count = std::min(count, limit);
+	}
+
+	const int depth = workingFormat(reader.imageFormat()) == QImage::Format_ARGB32? 4 : 8;
+	return (qint64) size.width() * size.height() * depth * count;
+}
+
+qint64 decodedBytes(const QString & fileName, int limit)
+{
+	QImageReader reader(fileName);
+	return decodedBytes(reader, limit);
+}
+
+qint64 decodedBytes(QIODevice * device, int limit)
+{
+	QImageReader reader(device);
+	return decodedBytes(reader, limit);
+}
+
+void normalize(QVector<QImage> & frames)
+{
+	QtConcurrent::blockingMap(frames, [](QImage & frame)
+	{
+		frame = frame.convertToFormat(workingFormat(frame));
+	});
+}
+
+static QVector<QImage> read(QImageReader & reader, QString * error, int limit)
+{
+	reader.setAutoTransform(true);
+
+	QVector<QImage> frames;
+	int count = std::max(1, reader.imageCount());
+
+	if(limit > 0)
+	{
+		count = std::min(count, limit);
+	}
+
+	frames.reserve(count);
+
+//GIF and WebP advance on read(), TIFF pages only advance by jumping; jumping after a read that advanced skips a frame
+	for(int i = 0; i < count; ++i)
+	{
+		const int before = reader.currentImageNumber();
+		QImage frame = reader.read();
+
+		if(frame.isNull())
+		{
+			break;
+		}
+
+		frames.push_back(frame);
+
+		if(reader.currentImageNumber() == before)
+		{
+			reader.jumpToNextImage();
+		}
+	}
+
+	if(frames.isEmpty() && error)
+	{
+		*error = reader.errorString();
+	}
+
+	normalize(frames);
+	return frames;
+}
+
+QVector<QImage> read(const QString & fileName, QString * error, int limit)
+{
+	QImageReader reader(fileName);
+	return read(reader, error, limit);
+}
+
+QVector<QImage> read(QIODevice * device, QString * error, int limit)
+{
+	QImageReader reader(device);
+	return read(reader, error, limit);
+}
+
+QVector<QImage> render(const QVector<QImage> & frames, const QVector<QImage> & modifiers, const TransformParams & params, Quality quality)
+{
+//with fewer frames than cores each frame is split into bands instead
+	if(frames.size() < QThread::idealThreadCount())
+	{
+		QVector<QImage> renders;
+		renders.reserve(frames.size());
+
+		for(const QImage & frame : frames)
+		{
+			renders.push_back(ImageTransform::render(frame, modifiers, params, nullptr, nullptr, 0, quality));
+		}
+
+		return renders;
+	}
+
+	QVector<QImage> renders(frames.size());
+	QImage * out = renders.data();
+
+	Scheduler::map(Scheduler::current(), frames.size(), [&frames, &modifiers, &params, quality, out](int i)
+	{
+		out[i] = ImageTransform::render(frames[i], modifiers, params, nullptr, nullptr, 1, quality);
+	});
+
+	return renders;
+}
+
+QVector<QImage> thumbnails(const QVector<QImage> & frames, int size)
+{
+	QVector<QImage> shrunk(frames.size());
+	QImage * out = shrunk.data();
+
+	Scheduler::map(Scheduler::current(), frames.size(), [&frames, size, out](int i)
+	{
+		const QSize bound = frames[i].size().scaled(size, size, Qt::KeepAspectRatio).expandedTo(QSize(1, 1));
+		out[i] = ImageTransform::region(frames[i], frames[i].rect(), bound.boundedTo(frames[i].size())).copy();
+	});
+
+	return shrunk;
+}
+
+bool write(const QString & fileName, const QVector<QImage> & frames, QString * error)
+{
+	QImageWriter writer(fileName);
+
+//handlers that take animations append every write() to the same file
+	if(frames.size() == 1 || writer.supportsOption(QImageIOHandler::Animation))
+	{
+		for(const QImage & frame : frames)
+		{
+			if(!writer.write(frame))
+			{
+				if(error) *error = writer.errorString();
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	const QFileInfo output(fileName);
+	const QString suffix = output.suffix().isEmpty()? QString("png") : output.suffix();
+	const int digits = std::max(4, QString::number(frames.size()-1).length());
+
+	for(int i = 0; i < frames.size(); ++i)
+	{
+		QImageWriter page(QString("%1/%2_%3.%4")
+			.arg(output.path(), output.completeBaseName())
+			.arg(i, digits, 10, QChar('0'))
+			.arg(suffix));
+
+		if(!page.write(frames[i]))
+		{
+			if(error) *error = page.errorString();
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
@@ -0,0 +1,38 @@
+#ifndef IMAGESEQUENCE_H
+#define IMAGESEQUENCE_H
+#include <QImage>
+#include <QVector>
+#include "colortransform.h"
+
+class QIODevice;
+
+//files holding several images, like animated GIFs and multi-page TIFFs
+namespace ImageSequence
+{
+//frames are ARGB32, or RGBA64 for sources with 16 bit channels when Qt is 5.12 or later
+	QImage::Format workingFormat(const QImage & image);
+	QImage::Format workingFormat(QImage::Format format);
+
+//what read() will hold for fileName in its working format, from the header alone; 0 if the size is not known up front
+	qint64 decodedBytes(const QString & fileName, int limit = 0);
+	qint64 decodedBytes(QIODevice * device, int limit = 0);
+
+//every frame of fileName (up to limit if it is not 0), one for a still image; empty with error set if nothing could be read
+	QVector<QImage> read(const QString & fileName, QString * error = nullptr, int limit = 0);
+//the same from encoded data, such as the clipboard's; the format is told by the contents
+	QVector<QImage> read(QIODevice * device, QString * error = nullptr, int limit = 0);
+
+//converts decoded frames to their working format, several at a time
+	void normalize(QVector<QImage> & frames);
+
+//all frames transformed with the same params, several frames at a time when there are enough to fill the cores
+	QVector<QImage> render(const QVector<QImage> & frames, const QVector<QImage> & modifiers, const TransformParams & params, Quality quality = QualityExact);
+
+//nearest neighbour copies that fit in size x size, for the frame list
+	QVector<QImage> thumbnails(const QVector<QImage> & frames, int size);
+
+//all frames into fileName if its format writes animations, otherwise as name_0000.ext, name_0001.ext...
+	bool write(const QString & fileName, const QVector<QImage> & frames, QString * error = nullptr);
+}
+
+#endif // IMAGESEQUENCE_H
@@ -0,0 +1,540 @@
+#include "imagetransform.h"
+#include "scheduler.h"
+#include "memoryaccountant.h"
+#include <QJsonArray>
+#include <QThread>
+#include <algorithm>
+#include <cstring>
+
+namespace ImageTransform
+{
+
+static const int rowsPerBand = 16;
+
+int bandCount(int height, int threads)
+{
+	if(threads <= 0)
+	{
+		threads = QThread::idealThreadCount();
+	}
+
+//a few bands per thread keeps the cores busy when rows differ in cost
+	int bands = threads > 1? threads * 4 : 1;
+	return std::max(1, std::min(bands, height / rowsPerBand));
+}
+
+void forEachBand(int height, int bands, const std::function<void (int begin, int end, int band)> & fn)
+{
+	if(bands <= 1)
+	{
+		fn(0, height, 0);
+		return;
+	}
+
+//bands run in the class of the caller, so higher work can take the threads between them
+	Scheduler::map(Scheduler::current(), bands, [height, bands, &fn](int band)
+	{
+		fn((int64_t) height * band / bands, (int64_t) height * (band+1) / bands, band);
+	});
+}
+
+//runs fn over bands, each with its own partial stats, then merges them into stats
+static void forEachRow(int height, int threads, RenderStats * stats, const std::function<void (int y, RenderStats * stats)> & fn)
+{
+	const int bands = bandCount(height, threads);
+	std::vector<RenderStats> partial(stats? bands : 0);
+
+	for(RenderStats & it : partial)
+	{
+		it.clear();
+	}
+
+	forEachBand(height, bands, [&](int begin, int end, int band)
+	{
+		RenderStats * local = stats? &partial[band] : nullptr;
+
+		for(int y = begin; y < end; ++y)
+		{
+			fn(y, local);
+		}
+	});
+
+	if(stats)
+	{
+		stats->clear();
+
+		for(const RenderStats & it : partial)
+		{
+			stats->merge(it);
+		}
+	}
+}
+
+void swapPigments(std::vector<Vector3> & swap, const QImage & original, const uint8_t * pigments, int threads)
+{
+	swap.resize((size_t) original.width() * original.height());
+
+	forEachRow(original.height(), threads, nullptr, [&](int y, RenderStats *)
+	{
+		ColorTransform::swapRow(swap.data() + (size_t) y * original.width(),
+			(const uint32_t *) original.constScanLine(y), original.width(), pigments);
+	});
+}
+
+//the modifier image each wide column reads, null where it is not loaded or does not match the source
+static void wideSources(const QImage ** images, const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params)
+{
+	for(int i = 0; i < params.modifierCount; ++i)
+	{
+		const int index = params.modifierChannel[i] / 4;
+		const bool usable = index < modifiers.size() && modifiers[index].size() == original.size() && modifiers[index].format() == original.format();
+		images[i] = usable? &modifiers[index] : nullptr;
+	}
+}
+
+static void wideRows(ColorTransform::ModifierRow * rows, const QImage * const * images, const TransformParams & params, int y)
+{
+	for(int i = 0; i < params.modifierCount; ++i)
+	{
+		rows[i].pixels  = images[i]? images[i]->constScanLine(y) : nullptr;
+		rows[i].channel = params.modifierChannel[i] % 4;
+	}
+}
+
+//16 bit images, every quality tier and kind goes through the 16 bit kernels
+static void applyDeep(QImage & render, const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params,
+					  RenderStats * stats, int channels, int threads)
+{
+	const int width = original.width();
+
+	uchar * bits = render.bits();
+	const int stride = render.bytesPerLine();
+	auto dst = [bits, stride](int y) { return (uint64_t *) (bits + (size_t) y * stride); };
+	auto src = [&original](int y) { return (const uint64_t *) original.constScanLine(y); };
+
+	if(params.kind == RenderMatrix && params.modifierCount)
+	{
+		float wide[WIDE_SIZE];
+		const QImage * images[MODIFIER_CHANNELS];
+		ColorTransform::prepareWide(wide, params);
+		wideSources(images, original, modifiers, params);
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::ModifierRow rows[MODIFIER_CHANNELS];
+			wideRows(rows, images, params, y);
+			ColorTransform::wideRow64(dst(y), src(y), rows, params.modifierCount, width, wide, channels, local);
+		});
+		return;
+	}
+
+	const QImage modifier = modifiers.value(0);
+	float mat[MATRIX_SIZE], offset[3];
+
+	if(ColorTransform::prepareAffine(mat, offset, params))
+	{
+		const bool useModifier = params.kind == RenderMatrix && modifier.size() == original.size() && modifier.format() == original.format();
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			const uint64_t * mod = useModifier? (const uint64_t *) modifier.constScanLine(y) : nullptr;
+			ColorTransform::affineRow64(dst(y), src(y), mod, width, mat, offset, channels, local);
+		});
+		return;
+	}
+
+	switch(params.kind)
+	{
+	case RenderPigments:
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::pigmentsRow64(dst(y), src(y), width, params.pigments, local);
+		});
+		break;
+	case RenderNegate:
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::negateRow64(dst(y), src(y), width, local);
+		});
+		break;
+	default:
+		if(stats) measure(render, *stats, threads);
+		break;
+	}
+}
+
+void apply(QImage & render, const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params,
+		   const std::vector<Vector3> * swap, RenderStats * stats, int channels, int threads, Quality quality)
+{
+	if(isDeep(original))
+	{
+		applyDeep(render, original, modifiers, params, stats, channels, threads);
+		return;
+	}
+
+	const int width = original.width();
+
+//detach once up front, scanLine() must not copy from inside the workers
+	uchar * bits = render.bits();
+	const int stride = render.bytesPerLine();
+	auto dst = [bits, stride](int y) { return (uint32_t *) (bits + (size_t) y * stride); };
+	auto src = [&original](int y) { return (const uint32_t *) original.constScanLine(y); };
+
+	if(quality == QualityPreview && !params.linear && ColorTransform::lutSupported(params.kind))
+	{
+		std::vector<uint32_t> lut(ColorTransform::LutSize);
+		MemoryAccountant::Account lutAccount(MemoryAccountant::CategoryScratch, lut.size() * sizeof(uint32_t));
+		ColorTransform::buildLut(lut.data(), params);
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::lutRow(dst(y), src(y), width, lut.data(), local);
+		});
+		return;
+	}
+
+//the wide matrix has one kernel per gamma and linear light, quality does not change it
+	if(params.kind == RenderMatrix && params.modifierCount)
+	{
+		float wide[WIDE_SIZE];
+		const QImage * images[MODIFIER_CHANNELS];
+		ColorTransform::prepareWide(wide, params);
+		wideSources(images, original, modifiers, params);
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::ModifierRow rows[MODIFIER_CHANNELS];
+			wideRows(rows, images, params, y);
+
+			if(params.linear)
+				ColorTransform::wideRowLinear(dst(y), src(y), rows, params.modifierCount, width, wide, channels, local);
+			else
+				ColorTransform::wideRow(dst(y), src(y), rows, params.modifierCount, width, wide, channels, local);
+		});
+		return;
+	}
+
+	const QImage modifier = modifiers.value(0);
+
+//linear light decodes and encodes inside the kernel, so it is one pass like the others
+	float mat[MATRIX_SIZE], offset[3];
+
+	if(params.linear && ColorTransform::prepareAffine(mat, offset, params))
+	{
+		const bool useModifier = params.kind == RenderMatrix && modifier.size() == original.size() && modifier.format() == original.format();
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			const uint32_t * mod = useModifier? (const uint32_t *) modifier.constScanLine(y) : nullptr;
+			ColorTransform::affineRowLinear(dst(y), src(y), mod, width, mat, offset, channels, local);
+		});
+		return;
+	}
+
+	if(params.linear && params.kind == RenderPigments)
+	{
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::pigmentsRowLinear(dst(y), src(y), width, params.pigments, local);
+		});
+		return;
+	}
+
+	switch(params.kind)
+	{
+	case RenderMatrix:
+	{
+		float mat[MATRIX_SIZE];
+		ColorTransform::prepareMatrix(mat, params.matrix);
+
+		const bool useModifier = modifier.size() == original.size() && modifier.format() == original.format();
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			const uint32_t * mod = useModifier? (const uint32_t *) modifier.constScanLine(y) : nullptr;
+			ColorTransform::matrixRow(dst(y), src(y), mod, width, mat, channels, local);
+		});
+	} break;
+	case RenderAngles:
+	{
+		Quaternion q = ColorTransform::prepareAngles(params.angles);
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			if(quality == QualityExact)
+				ColorTransform::anglesRow(dst(y), src(y), width, q, local);
+			else
+				ColorTransform::anglesRowFast(dst(y), src(y), width, q, local);
+		});
+	} break;
+	case RenderPigments:
+	{
+		if(quality != QualityExact)
+		{
+			forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+			{
+				ColorTransform::pigmentsRowFast(dst(y), src(y), width, params.pigments, local);
+			});
+			break;
+		}
+
+		std::vector<Vector3> local;
+
+		if(swap == nullptr)
+		{
+			swapPigments(local, original, params.pigments, threads);
+			swap = &local;
+		}
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::tintRow(dst(y), src(y), swap->data() + (size_t) y * width, width, params.pigments, local);
+		});
+	} break;
+	case RenderHSV:
+	{
+		float mat[9];
+		ColorTransform::prepareHSV(mat, params.hsv);
+
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::hsvRow(dst(y), src(y), width, mat, local);
+		});
+	} break;
+	case RenderNegate:
+		forEachRow(original.height(), threads, stats, [&](int y, RenderStats * local)
+		{
+			ColorTransform::negateRow(dst(y), src(y), width, local);
+		});
+		break;
+	default:
+		if(stats) measure(render, *stats, threads);
+		break;
+	}
+}
+
+void apply(QImage & render, const QImage & original, const QImage & modifier, const TransformParams & params,
+		   const std::vector<Vector3> * swap, RenderStats * stats, int channels, int threads, Quality quality)
+{
+	apply(render, original, QVector<QImage>() << modifier, params, swap, stats, channels, threads, quality);
+}
+
+void measure(const QImage & image, RenderStats & stats, int threads)
+{
+	const bool deep = isDeep(image);
+
+	forEachRow(image.height(), threads, &stats, [&](int y, RenderStats * local)
+	{
+		if(deep)
+			ColorTransform::statsRow64((const uint64_t *) image.constScanLine(y), image.width(), local);
+		else
+			ColorTransform::statsRow((const uint32_t *) image.constScanLine(y), image.width(), local);
+	});
+}
+
+bool isDeep(const QImage & image)
+{
+	return image.depth() == 64;
+}
+
+QImage region(const QImage & image, const QRect & rect, const QSize & size)
+{
+	const QRect bounds = rect & image.rect();
+
+	if(bounds.isEmpty())
+	{
+		return QImage();
+	}
+
+	QImage view(image.constScanLine(bounds.top()) + bounds.left() * (image.depth() / 8),
+				bounds.width(), bounds.height(), image.bytesPerLine(), image.format());
+
+	if(size.isValid() && (size.width() < bounds.width() || size.height() < bounds.height()))
+	{
+		return view.scaled(size.boundedTo(bounds.size()), Qt::IgnoreAspectRatio, Qt::FastTransformation);
+	}
+
+	return view;
+}
+
+QImage render(const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params,
+			  const std::vector<Vector3> * swap, RenderStats * stats, int threads, Quality quality)
+{
+	if(params.kind == RenderNone || original.isNull())
+	{
+		if(stats) measure(original, *stats, threads);
+		return original;
+	}
+
+	QImage render(original.size(), original.format());
+	render.fill(0);
+
+	apply(render, original, modifiers, params, swap, stats, 0x07, threads, quality);
+	return render;
+}
+
+QImage render(const QImage & original, const QImage & modifier, const TransformParams & params,
+			  const std::vector<Vector3> * swap, RenderStats * stats, int threads, Quality quality)
+{
+	return render(original, QVector<QImage>() << modifier, params, swap, stats, threads, quality);
+}
+
+static const char * kindNames[] = { "none", "matrix", "angles", "pigments", "negate", "hsv" };
+
+TransformParams defaultParams(RenderKind kind)
+{
+	TransformParams params;
+	params.kind = kind;
+
+	memset(params.matrix, 0, sizeof(params.matrix));
+	memset(params.angles, 0, sizeof(params.angles));
+	memset(params.pigments, 128, sizeof(params.pigments));
+	params.hsv[0] = 0;
+	params.hsv[1] = 128;
+	params.hsv[2] = 128;
+	params.linear = false;
+
+	params.modifierCount = 0;
+	memset(params.wide, 0, sizeof(params.wide));
+
+	for(int i = 0; i < MODIFIER_CHANNELS; ++i)
+	{
+		params.modifierChannel[i] = i;
+	}
+
+	for(size_t y = 0; y < MATRIX_ROWS; ++y)
+	{
+		params.matrix[y + y*MATRIX_COLS] = 255;
+		params.wide[y + y*WIDE_COLS]     = 255;
+	}
+
+	return params;
+}
+
+void setModifierCount(TransformParams & params, int count)
+{
+	count = std::max(0, std::min(MODIFIER_CHANNELS, count));
+
+	if(count == params.modifierCount)
+	{
+		return;
+	}
+
+	if(params.modifierCount == 0)
+	{
+		memset(params.wide, 0, sizeof(params.wide));
+
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			memcpy(params.wide + y*WIDE_COLS, params.matrix + y*MATRIX_COLS, MATRIX_COLS);
+		}
+
+		params.modifierChannel[0] = 0;
+		params.modifierChannel[1] = 1;
+	}
+	else if(count == 0)
+	{
+		memset(params.matrix, 0, sizeof(params.matrix));
+
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			memcpy(params.matrix + y*MATRIX_COLS, params.wide + y*WIDE_COLS, std::min<int>(MATRIX_COLS, 3 + params.modifierCount));
+		}
+	}
+
+//columns past the count are cleared so that widening again starts them at 0
+	for(int y = 0; y < MATRIX_ROWS; ++y)
+	{
+		memset(params.wide + y*WIDE_COLS + 3 + count, 0, MODIFIER_CHANNELS - count);
+	}
+
+	params.modifierCount = count;
+}
+
+static void readArray(uint8_t * dst, int size, const QJsonValue & value)
+{
+	QJsonArray array = value.toArray();
+
+	for(int i = 0; i < size && i < array.size(); ++i)
+	{
+		dst[i] = std::max(0, std::min(255, array[i].toInt()));
+	}
+}
+
+static QJsonArray writeArray(const uint8_t * src, int size)
+{
+	QJsonArray array;
+
+	for(int i = 0; i < size; ++i)
+	{
+		array.append(src[i]);
+	}
+
+	return array;
+}
+
+TransformParams paramsFromJson(const QJsonObject & json)
+{
+	TransformParams params = defaultParams();
+
+	const QString name = json.value("transform").toString();
+	for(int i = 0; i < (int) (sizeof(kindNames) / sizeof(kindNames[0])); ++i)
+	{
+		if(name == kindNames[i]) params.kind = (RenderKind) i;
+	}
+
+	readArray(params.matrix, sizeof(params.matrix), json.value("matrix"));
+	readArray(params.angles, sizeof(params.angles), json.value("angles"));
+	readArray(params.pigments, sizeof(params.pigments), json.value("pigments"));
+	readArray(params.hsv, sizeof(params.hsv), json.value("hsv"));
+	params.linear = json.value("linear").toBool(false);
+
+	const QJsonArray channels = json.value("modifierChannels").toArray();
+
+	if(!channels.isEmpty())
+	{
+		setModifierCount(params, channels.size());
+		readArray(params.modifierChannel, params.modifierCount, channels);
+
+		uint8_t wide[MATRIX_ROWS * WIDE_COLS];
+		const int cols = params.matrixCols();
+		memcpy(wide, params.wide, sizeof(wide));
+		readArray(wide, MATRIX_ROWS * cols, json.value("wide"));
+
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			memcpy(params.wide + y*WIDE_COLS, wide + y*cols, cols);
+		}
+	}
+
+	return params;
+}
+
+QJsonObject paramsToJson(const TransformParams & params)
+{
+	QJsonObject json;
+	json.insert("transform", kindNames[params.kind]);
+	json.insert("matrix",   writeArray(params.matrix, sizeof(params.matrix)));
+	json.insert("angles",   writeArray(params.angles, sizeof(params.angles)));
+	json.insert("pigments", writeArray(params.pigments, sizeof(params.pigments)));
+	json.insert("hsv",      writeArray(params.hsv, sizeof(params.hsv)));
+	json.insert("linear",   params.linear);
+
+	if(params.modifierCount)
+	{
+		uint8_t wide[MATRIX_ROWS * WIDE_COLS];
+		const int cols = params.matrixCols();
+
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			memcpy(wide + y*cols, params.wide + y*WIDE_COLS, cols);
+		}
+
+		json.insert("modifierChannels", writeArray(params.modifierChannel, params.modifierCount));
+		json.insert("wide", writeArray(wide, MATRIX_ROWS * cols));
+	}
+
+	return json;
+}
+
+}
@@ -0,0 +1,54 @@
+#ifndef IMAGETRANSFORM_H
+#define IMAGETRANSFORM_H
+#include <QImage>
+#include <QJsonObject>
+#include <QVector>
+#include <functional>
+#include <vector>
+#include "colortransform.h"
+
+//whole-image passes over ARGB32 images, or RGBA64 ones on Qt 5.12 and later, safe to call from worker threads
+//threads: 0 picks one band per core, 1 runs on the calling thread (use from inside other parallel work)
+namespace ImageTransform
+{
+	int  bandCount(int height, int threads = 0);
+	void forEachBand(int height, int bands, const std::function<void (int begin, int end, int band)> & fn);
+
+	void swapPigments(std::vector<Vector3> & swap, const QImage & original, const uint8_t * pigments, int threads = 0);
+
+//writes into an existing render of the same size and format; swap may hold a precomputed swap stage for params.pigments[3..5]
+//quality only changes angles, pigments and hsv; the faster tiers and linear light ignore swap
+//modifiers are the loaded modifier images in order, the classic matrix reads the first; ones of another size or format read as 0
+	void apply(QImage & render, const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params,
+			   const std::vector<Vector3> * swap = nullptr, RenderStats * stats = nullptr, int channels = 0x07, int threads = 0,
+			   Quality quality = QualityExact);
+	void apply(QImage & render, const QImage & original, const QImage & modifier, const TransformParams & params,
+			   const std::vector<Vector3> * swap = nullptr, RenderStats * stats = nullptr, int channels = 0x07, int threads = 0,
+			   Quality quality = QualityExact);
+	void measure(const QImage & image, RenderStats & stats, int threads = 0);
+
+//16 bits per channel; apply() writes those with the 16 bit kernels, which ignore swap and quality
+	bool isDeep(const QImage & image);
+
+//the pixels of rect without copying them (image must outlive the result), or a nearest neighbour downscale if size is smaller
+	QImage region(const QImage & image, const QRect & rect, const QSize & size = QSize());
+
+	QImage render(const QImage & original, const QVector<QImage> & modifiers, const TransformParams & params,
+				  const std::vector<Vector3> * swap = nullptr, RenderStats * stats = nullptr, int threads = 0,
+				  Quality quality = QualityExact);
+	QImage render(const QImage & original, const QImage & modifier, const TransformParams & params,
+				  const std::vector<Vector3> * swap = nullptr, RenderStats * stats = nullptr, int threads = 0,
+				  Quality quality = QualityExact);
+
+//{"transform": "matrix", "matrix": [...], "angles": [...], "pigments": [...], "hsv": [...], "linear": false}, missing entries keep the defaults;
+//a wide matrix adds "modifierChannels": [...] and "wide": [...], 3 rows of 3 + modifierChannels.size() entries
+	TransformParams defaultParams(RenderKind kind = RenderNone);
+	TransformParams paramsFromJson(const QJsonObject & json);
+	QJsonObject     paramsToJson(const TransformParams & params);
+
+//switches between the classic matrix (count 0) and a wide one of count modifier columns, keeping the weights both share;
+//the classic matrix reads the red and green of the first modifier, so that is what its columns become
+	void setModifierCount(TransformParams & params, int count);
+}
+
+#endif // IMAGETRANSFORM_H
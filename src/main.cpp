@@ -1,11 +1,97 @@
 #include "mainwindow.h"
+#include "validation.h"
+#include "renderdaemon.h"
+#include "folderwatcher.h"
+#include "framestream.h"
+#include "timeline.h"
+#include "memoryaccountant.h"
+#include "sessionrecorder.h"
 #include <QApplication>
+#include <QCommandLineParser>
+#include <cstdio>
+#include <cstring>
+
+static bool hasOption(int argc, char *argv[], const char * option)
+{
+	for(int i = 1; i < argc; ++i)
+	{
+		if(!strcmp(argv[i], option)) return true;
+	}
+
+	return false;
+}
 
 int main(int argc, char *argv[])
 {
+	Timeline::start();
+
+	if(hasOption(argc, argv, "--validate"))
+	{
+		QCoreApplication a(argc, argv);
+		return Validation::run(a.arguments());
+	}
+
+	if(hasOption(argc, argv, "--daemon"))
+	{
+		QCoreApplication a(argc, argv);
+		return RenderDaemon::run(a.arguments());
+	}
+
+	if(hasOption(argc, argv, "--watch"))
+	{
+		QCoreApplication a(argc, argv);
+		return FolderWatcher::run(a.arguments());
+	}
+
+	if(hasOption(argc, argv, "--stream"))
+	{
+		QCoreApplication a(argc, argv);
+		return FrameStream::run(a.arguments());
+	}
+
+//the window is made and painted as usual, offscreen unless another platform is asked for
+	if(hasOption(argc, argv, "--replay"))
+	{
+		if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+
+		QApplication a(argc, argv);
+		return SessionRecorder::replay(a.arguments());
+	}
+
 	QApplication a(argc, argv);
+
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addPositionalArgument("image", "Base image to open.", "[image]");
+	parser.addPositionalArgument("modifier", "Modifier image to open with it.", "[modifier]");
+	parser.addOption(QCommandLineOption("timeline", "Log startup milestones to stderr."));
+	parser.addOption(QCommandLineOption("memory-budget", "Evict caches, then refuse to open or render, past <MiB> of image buffers.", "MiB"));
+	parser.addOption(QCommandLineOption("record", "Record editor, zoom and scroll input to <file> for --replay.", "file"));
+	parser.process(a);
+
+	QString error;
+	if(parser.isSet("record") && !SessionRecorder::startRecording(parser.value("record"), &error))
+	{
+		fprintf(stderr, "Cannot record to %s: %s\n", qPrintable(parser.value("record")), qPrintable(error));
+	}
+
+	Timeline::setEnabled(parser.isSet("timeline"));
+	MemoryAccountant::setBudget(parser.value("memory-budget").toLongLong() * 1048576);
+	Timeline::mark("application created");
+
 	MainWindow w;
 	w.show();
+	Timeline::mark("window shown");
+
+	const QStringList files = parser.positionalArguments();
+
+	if(!files.isEmpty())
+	{
+		w.openDeferred(files[0], files.size() > 1? files[1] : QString());
+	}
 
-	return a.exec();
+	const int result = a.exec();
+	SessionRecorder::stopRecording();
+	return result;
 }
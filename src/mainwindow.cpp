@@ -6,55 +6,175 @@
 #include <QImageWriter>
 #include <QStandardPaths>
 #include <QFileDialog>
+#include <QFile>
 #include <QGuiApplication>
 #include <QClipboard>
 #include <QMimeData>
 #include <QPainter>
 #include <QDir>
+#include <QDockWidget>
+#include <QLabel>
+#include <QListWidget>
+#include <QProgressBar>
+#include <QBuffer>
+#include <QActionGroup>
+#include <QFileInfo>
+#include <QSet>
+#include <QJsonDocument>
+#include <QtConcurrent>
+#include <algorithm>
 #include <cmath>
 #include "quaternion.h"
+#include "imagetransform.h"
+#include "imagesequence.h"
 
 #include "matrixeditor.h"
 #include "rotationeditor.h"
 #include "pigmenteditor.h"
+#include "hsveditor.h"
+#include "sweepdialog.h"
+#include "comparisondialog.h"
+#include "fitdialog.h"
+#include "histogramview.h"
+#include "timeline.h"
+#include "scheduler.h"
+#include "imagemimedata.h"
+#include "memoryaccountant.h"
 #include <iostream>
 
 const static double zoomFactor = .8;
+const static int    renderCacheBudget = 256*1024;
+const static int    thumbnailSize = 96;
 
 MainWindow::MainWindow(QWidget *parent) :
 QMainWindow(parent),
+sourceMemory(MemoryAccountant::CategorySources),
+renderMemory(MemoryAccountant::CategoryRenders),
+cacheMemory(MemoryAccountant::CategoryRenderCache),
+tileMemory(MemoryAccountant::CategoryTiles),
+scratchMemory(MemoryAccountant::CategoryScratch),
+reservedRender(MemoryAccountant::CategoryRenders),
+loadMemory(MemoryAccountant::CategorySources),
+saveMemory(MemoryAccountant::CategoryRenders),
 ui(new Ui::MainWindow)
 {
 	ui->setupUi(this);
 
+	renderKind = RenderNone;
+	generation = 1;
+	nextGeneration = 2;
+	renderGeneration = 0;
+	pigmentSwapGeneration = 0;
+	renderCache.setMaxCost(renderCacheBudget);
+	lazyRender = false;
+	lazyRevision = 1;
+	lazyParams = ImageTransform::defaultParams();
+	paintMark = nullptr;
+	loadingFull = false;
+	quality = QualityExact;
+	currentFrame = 0;
+	renderQuality = QualityExact;
+	linear = false;
+	renderLinear = false;
+	previewDrags = true;
+	dragging = false;
+	clampingScroll = false;
+	savingAs = false;
+
+	memoryLabel = new QLabel(this);
+	statusBar()->addPermanentWidget(memoryLabel);
+
+	paintedTileCost = 0;
+	memoryTimer.setSingleShot(true);
+	memoryTimer.setInterval(250);
+	connect(&memoryTimer, &QTimer::timeout, this, &MainWindow::updateMemoryStatus);
+
+	busyBar = new QProgressBar(this);
+	busyBar->setRange(0, 0);
+	busyBar->setMaximumWidth(120);
+	busyBar->hide();
+	statusBar()->addPermanentWidget(busyBar);
+
+	QDockWidget * dock = new QDockWidget(tr("Statistics"), this);
+	dock->setObjectName("statisticsDock");
+	histogramView = new HistogramView(dock);
+	dock->setWidget(histogramView);
+	addDockWidget(Qt::RightDockWidgetArea, dock);
+	ui->menuEdit->addAction(dock->toggleViewAction());
+
+	frameDock = new QDockWidget(tr("Frames"), this);
+	frameDock->setObjectName("framesDock");
+	frameList = new QListWidget(frameDock);
+	frameList->setIconSize(QSize(thumbnailSize, thumbnailSize));
+	frameDock->setWidget(frameList);
+	addDockWidget(Qt::LeftDockWidgetArea, frameDock);
+	frameDock->hide();
+	connect(frameList, &QListWidget::currentRowChanged, this, &MainWindow::showFrame);
+
+	documents.resize(1);
+	activeDocument = 0;
+	ui->tabBar->addTab(tr("Untitled"));
+	connect(ui->tabBar, &QTabBar::currentChanged, this, &MainWindow::activateDocument);
+	connect(ui->tabBar, &QTabBar::tabCloseRequested, this, &MainWindow::closeDocument);
+
 	reset();
 
 	connect(ui->actionEdit_Matrix, &QAction::triggered, this, &MainWindow::editMatrix);
 	connect(ui->actionEdit_Angles, &QAction::triggered, this, &MainWindow::editAngles);
 	connect(ui->actionEdit_Pigments, &QAction::triggered, this, &MainWindow::editPigments);
+	connect(ui->actionEdit_HSV, &QAction::triggered, this, &MainWindow::editHSV);
+	connect(ui->actionCompare, &QAction::triggered, this, &MainWindow::compareParams);
+	connect(ui->actionFit_to_Example, &QAction::triggered, this, &MainWindow::fitExample);
+	connect(ui->actionRender_Visible_Only, &QAction::toggled, this, &MainWindow::setLazyRender);
+
+	QActionGroup * qualityGroup = new QActionGroup(this);
+	qualityGroup->addAction(ui->actionQuality_Exact);
+	qualityGroup->addAction(ui->actionQuality_Fast);
+	connect(ui->actionQuality_Exact, &QAction::triggered, this, [this]() { setQuality(QualityExact); });
+	connect(ui->actionQuality_Fast, &QAction::triggered, this, [this]() { setQuality(QualityFast); });
+	connect(ui->actionPreview_While_Dragging, &QAction::toggled, this, [this](bool checked) { previewDrags = checked; });
+	connect(ui->actionLinear_Light, &QAction::triggered, this, &MainWindow::setLinear);
 
 	connect(ui->actionClose, &QAction::triggered, this, &MainWindow::documentClose);
 	connect(ui->actionNew, &QAction::triggered, this, &MainWindow::documentNew);
 	connect(ui->actionLoad_Base, &QAction::triggered, this, &MainWindow::documentOpenOriginal);
 	connect(ui->actionLoad_Modifier, &QAction::triggered, this, &MainWindow::documentOpenModifier);
+	connect(ui->actionAdd_Modifier, &QAction::triggered, this, &MainWindow::documentAddModifier);
 	connect(ui->actionSave, &QAction::triggered, this, &MainWindow::documentSave);
 	connect(ui->actionSave_As, &QAction::triggered, this, &MainWindow::documentSaveAs);
+	connect(ui->actionExport_Sweep, &QAction::triggered, this, &MainWindow::exportSweep);
+	connect(ui->actionSave_Parameters, &QAction::triggered, this, &MainWindow::saveParams);
+	connect(ui->actionLoad_Parameters, &QAction::triggered, this, &MainWindow::loadParams);
 
+	connect(ui->actionCopy, &QAction::triggered, this, &MainWindow::editCopy);
+	connect(ui->actionPaste, &QAction::triggered, this, &MainWindow::editPaste);
 	connect(ui->actionReload, &QAction::triggered, this, &MainWindow::reset);
 	connect(ui->actionNegate, &QAction::triggered, this, &MainWindow::onNegate);
 
-	connect(ui->actionZoom_Out, &QAction::triggered, this, [this]() { zoom *= zoomFactor; ui->widget->repaint(); });
-	connect(ui->actionZoom_In, &QAction::triggered, this, [this]() { zoom *= 1 / zoomFactor; ui->widget->repaint(); });
-	connect(ui->actionZoom_100, &QAction::triggered, this, [this]() { zoom = 1.0; ui->widget->repaint(); });
+	connect(ui->actionZoom_Out, &QAction::triggered, this, [this]() { setZoom(zoom * zoomFactor); });
+	connect(ui->actionZoom_In, &QAction::triggered, this, [this]() { setZoom(zoom / zoomFactor); });
+	connect(ui->actionZoom_100, &QAction::triggered, this, [this]() { setZoom(1.0); });
+
+	addEvictors();
 
-	connect(ui->horizontalScrollBar, &QScrollBar::valueChanged, [this](int) { ui->widget->repaint(); });
-	connect(ui->verticalScrollBar, &QScrollBar::valueChanged, [this](int) { ui->widget->repaint(); });
+	connect(&loadWatcher, &QFutureWatcher<QVector<QImage> >::finished, this, &MainWindow::loaded);
+	connect(&saveWatcher, &QFutureWatcher<QString>::finished, this, &MainWindow::saved);
+	connect(&pasteWatcher, &QFutureWatcher<QVector<QImage> >::finished, this, &MainWindow::pasted);
+	connect(&copyWatcher, &QFutureWatcher<QImage>::finished, this, &MainWindow::updateBusy);
+
+	connect(ui->horizontalScrollBar, &QScrollBar::valueChanged, this, &MainWindow::scrolled);
+	connect(ui->verticalScrollBar, &QScrollBar::valueChanged, this, &MainWindow::scrolled);
 
 	ui->widget->window = this;
 }
 
 MainWindow::~MainWindow()
 {
+	MemoryAccountant::removeEvictors(this);
+	loadWatcher.waitForFinished();
+	saveWatcher.waitForFinished();
+	pasteWatcher.waitForFinished();
+	copyWatcher.waitForFinished();
 	delete ui;
 }
 
@@ -63,151 +183,540 @@ void MainWindow::reset()
 	memset(matrix, 0, MATRIX_SIZE);
 	memset(angles, 0, sizeof(angles));
 	memset(pigments, 128, sizeof(pigments));
+	hsv[0] = 0;
+	hsv[1] = 128;
+	hsv[2] = 128;
+	modifierCount = 0;
+	memset(wide, 0, sizeof(wide));
+
+	for(int i = 0; i < MODIFIER_CHANNELS; ++i)
+	{
+		modifierChannel[i] = i;
+	}
 
 	for(size_t y = 0; y < MATRIX_ROWS; ++y)
 	{
 		matrix[y + y*MATRIX_COLS] = 255;
+		wide[y + y*WIDE_COLS]     = 255;
 	}
 
 	zoom = 1.0;
+	tiles.clear();
 
 	render = original;
+	renderKind = RenderNone;
+	{
+		Scheduler::Scope scope(Scheduler::PriorityBulk);
+		ImageTransform::measure(render, renderStats);
+	}
+	histogramView->setStats(renderStats);
+	updateThumbnails();
+	updateScrollBars();
+	memoryChanged();
 	ui->widget->repaint();
 }
 
-uint8_t multiplyRow(const float * row, const uint8_t * colors)
+void MainWindow::invalidateSource()
+{
+	dropRenders(generation);
+	generation = nextGeneration++;
+	renderKind = RenderNone;
+	pigmentSwap.clear();
+	pigmentSwapGeneration = 0;
+	++lazyRevision;
+}
+
+//render keys start with the generation, and generations are never reused by another document
+void MainWindow::dropRenders(uint32_t generation)
+{
+	const QByteArray prefix((const char *) &generation, sizeof(generation));
+
+	for(const QByteArray & key : renderCache.keys())
+	{
+		if(key.startsWith(prefix))
+			renderCache.remove(key);
+	}
+}
+
+//in lazy mode only the parameters are kept, draw() transforms the visible tiles on demand
+bool MainWindow::deferRender(RenderKind kind)
 {
-	float r = 0;
-	for(int i = 0; i < MATRIX_COLS; ++i)
+//a full size render that does not fit the budget even with the caches evicted falls back to the tiles in view
+	if(!lazyRender && kind != RenderNone && !rendersInPlace(kind) && !renderCache.contains(renderKey(kind))
+	&& !reserveMemory(reservedRender, (qint64) original.bytesPerLine() * original.height()))
+	{
+		ui->actionRender_Visible_Only->blockSignals(true);
+		ui->actionRender_Visible_Only->setChecked(true);
+		ui->actionRender_Visible_Only->blockSignals(false);
+
+		lazyRender = true;
+		dropFullRenders();
+		statusBar()->showMessage(tr("Memory budget reached, only the visible part is rendered"));
+	}
+
+	if(!lazyRender)
 	{
-		r += colors[i] * row[i];
+		return false;
 	}
 
-	return r < 0? 0 : r < 255? (uint8_t) r : 255;
+	lazyParams = params(kind);
+	++lazyRevision;
+
+	render = QImage();
+	renderKind = kind;
+	renderStats.clear();
+	histogramView->setStats(renderStats);
+	updateThumbnails();
+	return true;
 }
 
+void MainWindow::setLazyRender(bool enabled)
+{
+	if(lazyRender == enabled)
+	{
+		return;
+	}
 
-void MainWindow::onNegate()
+	TransformParams current = lazyRender? lazyParams : params(renderKind);
+	lazyRender = enabled;
+
+	if(lazyRender)
+	{
+		dropFullRenders();
+	}
+
+	adoptParams(current);
+}
+
+void MainWindow::dropFullRenders()
 {
-	render = QImage(original.size(), QImage::Format_ARGB32);
-	render.fill(0);
+	renderCache.clear();
+	pigmentSwap = std::vector<Vector3>();
+	pigmentSwapGeneration = 0;
+	tiles.clear();
+	memoryChanged();
+}
 
-	for(int y = 0; y < original.height(); ++y)
+QImage MainWindow::renderRegion(const QRect & source, const QSize & size) const
+{
+	QImage region = ImageTransform::region(original, source, size);
+	QVector<QImage> others;
+
+	for(const QImage & it : modifierList())
 	{
-		for(int x = 0; x < original.width(); ++x)
-		{
-			QRgb pixel = original.pixel(x, y);
+		others << (it.size() == original.size()? ImageTransform::region(it, source, size) : QImage());
+	}
 
-			if(qAlpha(pixel) == 0)
-			{
-				continue;
-			}
+	return ImageTransform::render(region, others, lazyParams, nullptr, nullptr, 1, activeQuality());
+}
+
+//brings this window's accounts up to date, then shows the process wide total
+void MainWindow::updateMemoryStatus()
+{
+	qint64 sources = 0;
 
-			pixel = qRgba(-qRed(pixel) & 0xFF, -qGreen(pixel) & 0xFF, -qBlue(pixel) & 0xFF, qAlpha(pixel));
-			render.setPixel(x, y, pixel);
+//sources opened in several documents share their pixels and are counted once
+	QSet<const uchar *> counted;
+	auto count = [&counted, &sources](const QImage & image)
+	{
+		if(!image.isNull() && !counted.contains(image.constBits()))
+		{
+			counted.insert(image.constBits());
+			sources += image.byteCount();
 		}
+	};
+
+	count(original);
+	count(modifier);
+	for(const QImage & it : extraModifiers) count(it);
+	for(const QImage & it : frames) count(it);
+	for(const QImage & it : frameThumbnails) count(it);
+
+	for(int i = 0; i < documents.size(); ++i)
+	{
+		if(i == activeDocument) continue;
+
+		for(const QImage & it : documents[i].frames) count(it);
+		count(documents[i].modifier);
+		for(const QImage & it : documents[i].extraModifiers) count(it);
 	}
 
-	ui->widget->repaint();
+	sourceMemory.set(sources);
+
+//render is shared with original before the first transform, and with its cache entry after
+	const bool shared = render.isNull() || counted.contains(render.constBits()) || renderCache.contains(renderKey(renderKind));
+
+	renderMemory.set(shared? 0 : render.byteCount());
+	cacheMemory.set((qint64) renderCache.totalCost() * 1024);
+	tileMemory.set((qint64) tiles.cost() * 1024);
+	scratchMemory.set((qint64) pigmentSwap.size() * sizeof(Vector3));
+	reservedRender.set(0);
+
+	memoryLabel->setText(tr("Memory: %1 MiB, peak %2 MiB, image %3 MiB")
+						 .arg(MemoryAccountant::total() / 1048576.0, 0, 'f', 1)
+						 .arg(MemoryAccountant::peak() / 1048576.0, 0, 'f', 1)
+						 .arg(original.byteCount() / 1048576.0, 0, 'f', 1));
+	memoryLabel->setToolTip(MemoryAccountant::report() + "\n\n" + Scheduler::report());
 }
 
-void MainWindow::applyMatrix()
+void MainWindow::memoryChanged()
 {
-	render = QImage(original.size(), QImage::Format_ARGB32);
+	if(!memoryTimer.isActive())
+	{
+		memoryTimer.start();
+	}
+}
+
+//the accounts are refreshed first, so evictions start from what is really held
+bool MainWindow::reserveMemory(MemoryAccountant::Account & account, qint64 bytes)
+{
+	updateMemoryStatus();
+	return MemoryAccountant::reserve(account, bytes);
+}
+
+//caches go in the order they are cheapest to rebuild: other renders, the pigment swap stage, then the tiles in view
+void MainWindow::addEvictors()
+{
+	MemoryAccountant::addEvictor(this, 0, [this](qint64 bytes)
+	{
+		const qint64 before = cacheMemory.bytes();
+		renderCache.setMaxCost((int) std::max<qint64>(0, renderCache.totalCost() - (bytes + 1023) / 1024));
+		renderCache.setMaxCost(renderCacheBudget);
+		updateMemoryStatus();
+		return before - cacheMemory.bytes();
+	});
+
+	MemoryAccountant::addEvictor(this, 1, [this](qint64)
+	{
+		const qint64 before = scratchMemory.bytes();
+		pigmentSwap = std::vector<Vector3>();
+		pigmentSwapGeneration = 0;
+		updateMemoryStatus();
+		return before - scratchMemory.bytes();
+	});
+
+	MemoryAccountant::addEvictor(this, 2, [this](qint64)
+	{
+		const qint64 before = tileMemory.bytes();
+		tiles.clear();
+		updateMemoryStatus();
+		return before - tileMemory.bytes();
+	});
+}
+
+Quality MainWindow::activeQuality() const
+{
+	return dragging && previewDrags? QualityPreview : quality;
+}
+
+//renders for a dragged slider preempt everything else, the exact render after it is let go only preempts bulk work
+Scheduler::Priority MainWindow::renderPriority() const
+{
+	return activeQuality() == QualityPreview? Scheduler::PriorityInteractive : Scheduler::PriorityRefine;
+}
+
+void MainWindow::setQuality(Quality quality)
+{
+	const Quality before = activeQuality();
+	this->quality = quality;
+
+	if(activeQuality() != before)
+	{
+		adoptParams(params(renderKind));
+	}
+}
+
+void MainWindow::setLinear(bool linear)
+{
+	if(this->linear != linear)
+	{
+		TransformParams current = params(renderKind);
+		current.linear = linear;
+		adoptParams(current);
+	}
+}
+
+//editors report slider drags, which use the preview tier until the slider is let go
+void MainWindow::setDragging(bool dragging)
+{
+	SessionRecorder::recordDrag(dragging);
+
+	const Quality before = activeQuality();
+	this->dragging = dragging;
+
+	if(activeQuality() != before)
+	{
+		adoptParams(params(renderKind));
+	}
+}
+
+bool MainWindow::rendersInPlace(RenderKind kind) const
+{
+	return renderKind == kind && renderGeneration == generation && render.size() == original.size() && renderQuality == activeQuality() && renderLinear == linear;
+}
+
+//returns false if render can be updated in place from the last pass of the same kind
+bool MainWindow::beginRender(RenderKind kind)
+{
+	if(rendersInPlace(kind))
+	{
+		return false;
+	}
+
+	render = QImage(original.size(), original.format());
 	render.fill(0);
 
-	float mat[MATRIX_SIZE];
+	renderKind = kind;
+	renderGeneration = generation;
+	renderQuality = activeQuality();
+	renderLinear = linear;
+	return true;
+}
 
-	for(size_t y = 0; y < MATRIX_ROWS; ++y)
+TransformParams MainWindow::params(RenderKind kind) const
+{
+	TransformParams params;
+	params.kind = kind;
+	memcpy(params.matrix, matrix, sizeof(matrix));
+	memcpy(params.angles, angles, sizeof(angles));
+	memcpy(params.pigments, pigments, sizeof(pigments));
+	memcpy(params.hsv, hsv, sizeof(hsv));
+	params.linear = linear;
+	params.modifierCount = modifierCount;
+	memcpy(params.modifierChannel, modifierChannel, sizeof(modifierChannel));
+	memcpy(params.wide, wide, sizeof(wide));
+	return params;
+}
+
+void MainWindow::adoptParams(const TransformParams & params)
+{
+	memcpy(matrix, params.matrix, sizeof(matrix));
+	memcpy(angles, params.angles, sizeof(angles));
+	memcpy(pigments, params.pigments, sizeof(pigments));
+	memcpy(hsv, params.hsv, sizeof(hsv));
+	linear = params.linear;
+	modifierCount = params.modifierCount;
+	memcpy(modifierChannel, params.modifierChannel, sizeof(modifierChannel));
+	memcpy(wide, params.wide, sizeof(wide));
+	ui->actionLinear_Light->setChecked(linear);
+
+	switch(params.kind)
 	{
-		float sum = 0;
-		for(size_t x = 0; x < MATRIX_COLS; ++x)
+	case RenderMatrix:   applyMatrix();   break;
+	case RenderAngles:   applyAngles();   break;
+	case RenderPigments: applyPigments(); break;
+	case RenderNegate:   onNegate();      break;
+	case RenderHSV:      applyHSV();      break;
+	default:
+		if(!deferRender(RenderNone))
 		{
-			int i = y*MATRIX_COLS + x;
-			mat[i] = matrix[i] / 255.0;
-			sum += mat[i];
+			render = original;
+			renderKind = RenderNone;
+			updateThumbnails();
+			memoryChanged();
 		}
+		break;
+	}
+
+	ui->widget->repaint();
+}
+
+QByteArray MainWindow::renderKey(RenderKind kind) const
+{
+	QByteArray key;
+	key.append((const char *) &generation, sizeof(generation));
+	key.append((char) kind);
+	key.append((char) activeQuality());
+	key.append((char) linear);
+
+	switch(kind)
+	{
+	case RenderMatrix:
+		key.append((char) modifierCount);
 
-		if(sum > 1.0)
+		if(modifierCount)
 		{
-			for(size_t x = 0; x < MATRIX_COLS; ++x)
-			{
-				int i = y*MATRIX_COLS + x;
-				mat[i] = mat[i] / sum;
-			}
+			key.append((const char *) modifierChannel, modifierCount);
+			key.append((const char *) wide, sizeof(wide));
+		}
+		else
+		{
+			key.append((const char *) matrix, sizeof(matrix));
 		}
+		break;
+	case RenderAngles:
+		key.append((const char *) angles, sizeof(angles));
+		break;
+	case RenderPigments:
+		key.append((const char *) pigments, sizeof(pigments));
+		break;
+	case RenderHSV:
+		key.append((const char *) hsv, sizeof(hsv));
+		break;
+	default:
+		break;
 	}
 
-	for(int y = 0; y < original.height(); ++y)
+	return key;
+}
+
+bool MainWindow::fetchRender(RenderKind kind)
+{
+	CachedRender * cached = renderCache.object(renderKey(kind));
+
+	if(cached == nullptr)
 	{
-		for(int x = 0; x < original.width(); ++x)
-		{
-			QRgb pixel = original.pixel(x, y);
+		return false;
+	}
 
-			if(qAlpha(pixel) == 0)
-			{
-				continue;
-			}
+	render = cached->image;
+	renderStats = cached->stats;
+	histogramView->setStats(renderStats);
+	renderKind = kind;
+	renderGeneration = generation;
+	renderQuality = activeQuality();
+	renderLinear = linear;
+
+	memcpy(renderMatrix, matrix, sizeof(matrix));
+	memcpy(renderWide, wide, sizeof(wide));
+	renderModifierCount = modifierCount;
+	memcpy(renderModifierChannel, modifierChannel, sizeof(modifierChannel));
+	memcpy(renderAngles, angles, sizeof(angles));
+	memcpy(renderPigments, pigments, sizeof(pigments));
+	memcpy(renderHSV, hsv, sizeof(hsv));
+
+	updateThumbnails();
+	memoryChanged();
+	return true;
+}
 
-			uint8_t colors[MATRIX_COLS];
+void MainWindow::storeRender()
+{
+	if(render.isNull())
+	{
+		return;
+	}
 
-			colors[0] = qRed(pixel);
-			colors[1] = qGreen(pixel);
-			colors[2] = qBlue(pixel);
+	renderCache.insert(renderKey(renderKind), new CachedRender{render, renderStats}, std::max(1, render.byteCount() / 1024));
+}
 
-			if(modifier.isNull())
-			{
-				colors[3] = 0;
-				colors[4] = 0;
-			}
-			else
-			{
-				QRgb pixel = modifier.pixel(x, y);
+void MainWindow::finishRender()
+{
+	storeRender();
+	histogramView->setStats(renderStats);
+	updateThumbnails();
+	memoryChanged();
+}
 
-				colors[3] = qRed(pixel);
-				colors[4] = qGreen(pixel);
-			}
+void MainWindow::onNegate()
+{
+	Scheduler::Scope scope(renderPriority());
+
+	if(deferRender(RenderNegate) || fetchRender(RenderNegate) || !beginRender(RenderNegate))
+	{
+		ui->widget->repaint();
+		return;
+	}
+
+	ImageTransform::apply(render, original, modifierList(), params(RenderNegate), nullptr, &renderStats);
+
+	finishRender();
+	ui->widget->repaint();
+}
+
+void MainWindow::applyMatrix()
+{
+	Scheduler::Scope scope(renderPriority());
+
+	if(deferRender(RenderMatrix) || fetchRender(RenderMatrix))
+	{
+		return;
+	}
 
-			uint8_t red   = multiplyRow(mat + 0*MATRIX_COLS, colors);
-			uint8_t green = multiplyRow(mat + 1*MATRIX_COLS, colors);
-			uint8_t blue  = multiplyRow(mat + 2*MATRIX_COLS, colors);
-			uint8_t alpha = qAlpha(pixel);
+	int dirty = 0;
 
-			pixel = qRgba(red, green, blue, alpha);
-			render.setPixel(x, y, pixel);
+//a different width or column source changes what every row reads
+	if(beginRender(RenderMatrix) || modifierCount != renderModifierCount
+	|| memcmp(modifierChannel, renderModifierChannel, modifierCount))
+	{
+		dirty = 0x07;
+	}
+	else
+	{
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			const bool changed = modifierCount? memcmp(wide + y*WIDE_COLS, renderWide + y*WIDE_COLS, 3 + modifierCount)
+											  : memcmp(matrix + y*MATRIX_COLS, renderMatrix + y*MATRIX_COLS, MATRIX_COLS);
+			if(changed)
+				dirty |= 1 << y;
 		}
 	}
+
+	memcpy(renderMatrix, matrix, sizeof(matrix));
+	memcpy(renderWide, wide, sizeof(wide));
+	renderModifierCount = modifierCount;
+	memcpy(renderModifierChannel, modifierChannel, sizeof(modifierChannel));
+
+	if(!dirty)
+	{
+		return;
+	}
+
+	RenderStats previous = renderStats;
+	ImageTransform::apply(render, original, modifierList(), params(RenderMatrix), nullptr, &renderStats, dirty);
+
+//channels that were not recomputed keep the clamp counts of the pass that wrote them
+	for(int c = 0; c < 3; ++c)
+	{
+		if(!(dirty & (1 << c)))
+			renderStats.clamped[c] = previous.clamped[c];
+	}
+
+	finishRender();
 }
 
 void MainWindow::applyAngles()
 {
-	render = QImage(original.size(), QImage::Format_ARGB32);
-	render.fill(0);
-#ifndef M_PI
-#define M_PI 3.14159265358
-#endif
-	Quaternion q(angles[0] * M_PI / 128, angles[1] * M_PI / 128, angles[2] * M_PI / 128);
+	Scheduler::Scope scope(renderPriority());
 
-	for(int y = 0; y < original.height(); ++y)
+	if(deferRender(RenderAngles) || fetchRender(RenderAngles))
 	{
-		for(int x = 0; x < original.width(); ++x)
-		{
-			QRgb pixel = original.pixel(x, y);
+		return;
+	}
 
-			if(qAlpha(pixel) == 0)
-			{
-				continue;
-			}
+//every angle feeds the same quaternion, so any change dirties all three channels
+	if(!beginRender(RenderAngles) && !memcmp(angles, renderAngles, sizeof(angles)))
+	{
+		return;
+	}
 
-			Vector3 c = Vector3::fromColor(qRed(pixel), qGreen(pixel), qBlue(pixel));
-			float length = c.length();
-			c = q.rotate(c);
-			c.normalize();
-			c = c * length;
-			pixel = qRgba(c.red(), c.green(), c.blue(), qAlpha(pixel));
-			render.setPixel(x, y, pixel);
-		}
+	memcpy(renderAngles, angles, sizeof(angles));
+
+	ImageTransform::apply(render, original, modifierList(), params(RenderAngles), nullptr, &renderStats, 0x07, 0, activeQuality());
+
+	finishRender();
+}
+
+void MainWindow::applyHSV()
+{
+	Scheduler::Scope scope(renderPriority());
+
+	if(deferRender(RenderHSV) || fetchRender(RenderHSV))
+	{
+		return;
+	}
+
+//the three values fold into one 3x3 matrix, so any change dirties every channel
+	if(!beginRender(RenderHSV) && !memcmp(hsv, renderHSV, sizeof(hsv)))
+	{
+		return;
 	}
+
+	memcpy(renderHSV, hsv, sizeof(hsv));
+
+	ImageTransform::apply(render, original, modifierList(), params(RenderHSV), nullptr, &renderStats, 0x07, 0, activeQuality());
+
+	finishRender();
 }
 
 float MainWindow::applyPigment(float color, float pigment)
@@ -237,46 +746,6 @@ float MainWindow::applyPigment(float color, float pigment)
 	*/
 }
 
-Vector3 TransformHSV(
-        const Vector3 &in,  // color to transform
-        float H,          // hue shift (in degrees)
-        float S,          // saturation multiplier (scalar)
-        float V           // value multiplier (scalar)
-    )
-{
-
-
-    float VSU = V*S*cos(H);
-    float VSW = V*S*sin(H);
-
-    Vector3 ret;
-    ret.x = (.299*V+.701*VSU+.168*VSW)*in.x
-        + (.587*V-.587*VSU+.330*VSW)*in.y
-        + (.114*V-.114*VSU-.497*VSW)*in.z;
-    ret.y = (.299*V-.299*VSU-.328*VSW)*in.x
-        + (.587*V+.413*VSU+.035*VSW)*in.y
-        + (.114*V-.114*VSU+.292*VSW)*in.z;
-    ret.z = (.299*V-.3*VSU+1.25*VSW)*in.x
-        + (.587*V-.588*VSU-1.05*VSW)*in.y
-        + (.114*V+.886*VSU-.203*VSW)*in.z;
-    return ret;
-}
-
-Vector3 TransformByExample(
-        const Vector3 &in,  // color to transform
-        const Vector3 &r,   // pre-transformed red
-        const Vector3 &g,   // pre-transformed green
-        const Vector3 &b,   // pre-transformed blue
-        float m  // Maximum value for a channel
-    )
-{
-    Vector3 ret;
-    ret.x = in.dot(r)/m;
-    ret.y = in.dot(g)/m;
-    ret.z = in.dot(b)/m;
-    return ret;
-}
-
 float GetHue(float r, float g, float b, float & saturation)
 {
 	saturation = 0;
@@ -323,72 +792,54 @@ QRgb rawColor(int r, int g, int b, int a = 255)
 	return (a << 24) | (r << 16) | (g << 8) | b;
 }
 
-void MainWindow::applyPigments()
+void MainWindow::swapPigments()
 {
-	float Pr = (pigments[0]/128.f);
-	float Pg = (pigments[1]/128.f);
-	float Pb = (pigments[2]/128.f);
-
-	float saturation = 0;
-	float value = std::max(Pr, std::max(Pg, Pb));
-	float hue = -GetHue(Pr, Pg, Pb, saturation);
+	memcpy(pigmentSwapParams, pigments + 3, sizeof(pigmentSwapParams));
+	pigmentSwapGeneration = generation;
 
-	const float swap_rg = (pigments[3] > 128? pigments[3] - 128 : 128 - pigments[3])/128.f;
-	const float swap_gb = (pigments[4] > 128? pigments[4] - 128 : 128 - pigments[4])/128.f;
-	const float swap_rb = (pigments[5] > 128? pigments[5] - 128 : 128 - pigments[5])/128.f;
+	ImageTransform::swapPigments(pigmentSwap, original, pigments);
+}
 
-	render = QImage(original.size(), QImage::Format_ARGB32);
-	render.fill(0);
+void MainWindow::applyPigments()
+{
+	Scheduler::Scope scope(renderPriority());
 
-	for(int y = 0; y < original.height(); ++y)
+	if(deferRender(RenderPigments) || fetchRender(RenderPigments))
 	{
-		for(int x = 0; x < original.width(); ++x)
-		{
-			QRgb px = original.pixel(x, y);
-
-			if(qAlpha(px) == 0)
-				continue;
-
-			Vector3 color(qRed(px)/256.f, qGreen(px)/256.f, qBlue(px)/256.f);
-			float brightness = (color.x + color.y+color.z)/3;// sqrt(color.x*color.x*.241 + color.y*color.y*.691+ color.z*color.z*.068);
-
-			float t = (brightness)*(1-brightness);
-
-			float chroma = std::max(color.x, std::max(color.y, color.z)) -  std::min(color.x, std::min(color.y, color.z));
-			float db = (Pr + Pg + Pb)/6 -.5;
-
-			color = Vector3(color.x*(1-swap_rg)*(1-swap_rb) + color.y*(swap_rg) + color.z*(swap_rb)
-			,
-							color.y*(1-swap_rg)*(1-swap_gb) + color.x*(swap_rg) + color.z*(swap_gb)
-			,
-							color.z*(1-swap_gb)*(1-swap_rb) + color.x*(swap_rb) + color.y*(swap_gb)
-			);
+		return;
+	}
 
-			color.x = color.x*(1-chroma) + (Pr <= 1.f? Pr*color.x : color.x + (1-color.x)*(Pr-1))*chroma + db;
-			color.y = color.y*(1-chroma) + (Pg <= 1.f? Pg*color.y : color.y + (1-color.y)*(Pg-1))*chroma + db;
-			color.z = color.z*(1-chroma) + (Pb <= 1.f? Pb*color.z : color.z + (1-color.z)*(Pb-1))*chroma + db;
+	bool fresh = beginRender(RenderPigments);
 
-			color.x = std::max(0.f, std::min(1.f, color.x));
-			color.y = std::max(0.f, std::min(1.f, color.y));
-			color.z = std::max(0.f, std::min(1.f, color.z));
+//the faster tiers, linear light and the 16 bit kernel fuse the swap stage into the kernel
+	if(activeQuality() != QualityExact || linear || ImageTransform::isDeep(original))
+	{
+		if(!fresh && !memcmp(renderPigments, pigments, sizeof(pigments)))
+		{
+			return;
+		}
 
-			float luma = (color.x + color.y+color.z)/3;
-			//sqrt(color.x*color.x*.241 + color.y*color.y*.691+ color.z*color.z*.068);
+		memcpy(renderPigments, pigments, sizeof(pigments));
+		ImageTransform::apply(render, original, modifierList(), params(RenderPigments), nullptr, &renderStats, 0x07, 0, activeQuality());
+		finishRender();
+		return;
+	}
 
-			luma  = (brightness*(1-t) + luma*t) - luma;
+	if(pigmentSwapGeneration != generation || memcmp(pigmentSwapParams, pigments + 3, sizeof(pigmentSwapParams)))
+	{
+		swapPigments();
+		fresh = true;
+	}
+	else if(!fresh && !memcmp(renderPigments, pigments, sizeof(pigments)))
+	{
+		return;
+	}
 
-			color.x += luma;
-			color.y += luma;
-			color.z += luma;
+	memcpy(renderPigments, pigments, sizeof(pigments));
 
-			color.x = std::max(0.f, std::min(1.f, color.x));
-			color.y = std::max(0.f, std::min(1.f, color.y));
-			color.z = std::max(0.f, std::min(1.f, color.z));
+	ImageTransform::apply(render, original, modifierList(), params(RenderPigments), &pigmentSwap, &renderStats);
 
-			px = qRgba(color.x*255, color.y*255, color.z*255, qAlpha(px));
-			render.setPixel(x, y, px);
-		}
-	}//*/
+	finishRender();
 
 #if 0
 	float acid     = std::cos(pigments[0]*M_PI/256);
@@ -488,6 +939,23 @@ void MainWindow::applyPigments()
 
 
 
+//asking every image plugin for its types is slow, so each list is built once
+static const QStringList & mimeTypeFilters(QFileDialog::AcceptMode acceptMode)
+{
+    static QStringList filters[2];
+    QStringList & list = filters[acceptMode == QFileDialog::AcceptOpen];
+
+    if (list.isEmpty()) {
+        const QByteArrayList supportedMimeTypes = acceptMode == QFileDialog::AcceptOpen
+            ? QImageReader::supportedMimeTypes() : QImageWriter::supportedMimeTypes();
+        foreach (const QByteArray &mimeTypeName, supportedMimeTypes)
+            list.append(mimeTypeName);
+        list.sort();
+    }
+
+    return list;
+}
+
 static void initializeImageFileDialog(QFileDialog &dialog, QFileDialog::AcceptMode acceptMode)
 {
     static bool firstDialog = true;
@@ -498,13 +966,7 @@ static void initializeImageFileDialog(QFileDialog &dialog, QFileDialog::AcceptMo
         dialog.setDirectory(picturesLocations.isEmpty() ? QDir::currentPath() : picturesLocations.last());
     }
 
-    QStringList mimeTypeFilters;
-    const QByteArrayList supportedMimeTypes = acceptMode == QFileDialog::AcceptOpen
-        ? QImageReader::supportedMimeTypes() : QImageWriter::supportedMimeTypes();
-    foreach (const QByteArray &mimeTypeName, supportedMimeTypes)
-        mimeTypeFilters.append(mimeTypeName);
-    mimeTypeFilters.sort();
-    dialog.setMimeTypeFilters(mimeTypeFilters);
+    dialog.setMimeTypeFilters(mimeTypeFilters(acceptMode));
     dialog.selectMimeTypeFilter("image/jpeg");
     if (acceptMode == QFileDialog::AcceptSave)
         dialog.setDefaultSuffix("jpg");
@@ -518,14 +980,86 @@ void MainWindow::documentOpenOriginal()
 	while (dialog.exec() == QDialog::Accepted && !openFile(&original, &modifier, dialog.selectedFiles().first())) {}
 }
 
-void MainWindow::documentOpenModifier()
+bool MainWindow::openImage(const QString & fileName)
 {
-	QFileDialog dialog(this, tr("Open File"));
-	initializeImageFileDialog(dialog, QFileDialog::AcceptOpen);
+	return openFile(&original, &modifier, fileName);
+}
+
+void MainWindow::replay(const SessionRecorder::Event & event)
+{
+	switch(event.type)
+	{
+	case SessionRecorder::EventEdit:
+		adoptParams(event.params);
+		break;
+	case SessionRecorder::EventDrag:
+		setDragging(event.dragging);
+		break;
+	case SessionRecorder::EventZoom:
+		setZoom(event.zoom);
+		break;
+	case SessionRecorder::EventScroll:
+	{
+		const QPoint before = scrollPosition;
+		ui->horizontalScrollBar->setValue(event.position.x());
+		ui->verticalScrollBar->setValue(event.position.y());
+
+//a scroll that the bars clamp back onto the same position moves nothing, but its input still waits for a frame
+		if(scrollPosition == before)
+			ui->widget->update();
+		break;
+	}
+	case SessionRecorder::EventResize:
+		resize(event.size);
+		break;
+	}
+}
+
+void MainWindow::documentOpenModifier()
+{
+	QFileDialog dialog(this, tr("Open File"));
+	initializeImageFileDialog(dialog, QFileDialog::AcceptOpen);
 
 	while (dialog.exec() == QDialog::Accepted && !openFile(&modifier, &original, dialog.selectedFiles().first())) {}
 }
 
+//the added modifier gets the next four channel numbers of the wide matrix; the classic one still only reads the first
+void MainWindow::documentAddModifier()
+{
+	if(original.isNull())
+	{
+		statusBar()->showMessage(tr("Open a base image first"));
+		return;
+	}
+
+	if(1 + extraModifiers.size() >= MODIFIER_CHANNELS)
+	{
+		statusBar()->showMessage(tr("No more than %1 modifiers can be loaded").arg(MODIFIER_CHANNELS));
+		return;
+	}
+
+	QFileDialog dialog(this, tr("Add Modifier"));
+	initializeImageFileDialog(dialog, QFileDialog::AcceptOpen);
+
+	extraModifiers.push_back(QImage());
+
+	while (dialog.exec() == QDialog::Accepted)
+	{
+		if(openFile(&extraModifiers.last(), &original, dialog.selectedFiles().first()))
+		{
+			statusBar()->showMessage(tr("Loaded modifier %1").arg(1 + extraModifiers.size()));
+			return;
+		}
+	}
+
+	extraModifiers.pop_back();
+}
+
+QVector<QImage> MainWindow::modifierList() const
+{
+	return QVector<QImage>() << modifier << extraModifiers;
+}
+
 void MainWindow::documentSave()
 {
 	if(filename.isNull())
@@ -540,24 +1074,94 @@ void MainWindow::documentSave()
 
 void MainWindow::documentSaveAs()
 {
+    if (saveWatcher.isRunning()) {
+        statusBar()->showMessage(tr("Still writing \"%1\"").arg(QDir::toNativeSeparators(savingName)));
+        return;
+    }
+
     QFileDialog dialog(this, tr("Save File As"));
     initializeImageFileDialog(dialog, QFileDialog::AcceptSave);
 
-    while (dialog.exec() == QDialog::Accepted && !saveFile(dialog.selectedFiles().first())) {}
+//writing fails later, in saved(), which opens this again
+    while (dialog.exec() == QDialog::Accepted && !saveFile(dialog.selectedFiles().first(), true)) {}
+}
+
+//a file is only shared while it has not changed on disk since it was decoded
+static QString sourceKey(const QString & fileName)
+{
+	const QFileInfo info(fileName);
+	const QString path = info.canonicalFilePath();
+
+	return path.isEmpty()? QString() : path + '|' + QString::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+//frames another document, or this one, already decoded from the same file; modifiers only have their first frame,
+//converted to their base's format, so they are only reused as a modifier of the same format
+QVector<QImage> MainWindow::sharedSource(const QString & key, bool base) const
+{
+	if(key.isEmpty())
+	{
+		return QVector<QImage>();
+	}
+
+	if(key == baseSource)
+	{
+		return base? frames : QVector<QImage>() << frames.first();
+	}
+
+	if(!base && key == modifierSource)
+	{
+		return QVector<QImage>() << modifier;
+	}
+
+	for(int i = 0; i < documents.size(); ++i)
+	{
+		const Document & document = documents[i];
+
+		if(i == activeDocument) continue;
+
+		if(document.baseSource == key)
+		{
+			return base? document.frames : QVector<QImage>() << document.frames.first();
+		}
+
+		if(!base && document.modifierSource == key && document.modifier.format() == original.format())
+		{
+			return QVector<QImage>() << document.modifier;
+		}
+	}
+
+	return QVector<QImage>();
 }
 
 bool MainWindow::openFile(QImage * image, QImage *other, const QString &fileName)
 {
-    QImageReader reader(fileName);
-    reader.setAutoTransform(true);
-    QImage newImage = reader.read();
-    if (newImage.isNull()) {
+    QString error;
+    const QString key = sourceKey(fileName);
+    QVector<QImage> newFrames = sharedSource(key, image == &original);
+//a modifier is converted to its base's format, the base keeps every frame in its working format
+    const QSize size = QImageReader(fileName).size();
+    const qint64 bytes = image == &original || original.isNull()
+                       ? ImageSequence::decodedBytes(fileName, image == &original? 0 : 1)
+                       : (size.isValid()? (qint64) size.width() * size.height() * (original.depth() / 8) : 0);
+    MemoryAccountant::Account reserved(MemoryAccountant::CategorySources);
+    if (newFrames.isEmpty() && bytes && !reserveMemory(reserved, bytes)) {
+        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+                                 tr("Cannot load %1: it does not fit the memory budget")
+                                 .arg(QDir::toNativeSeparators(fileName)));
+        return false;
+    }
+    if (newFrames.isEmpty())
+        newFrames = ImageSequence::read(fileName, &error, image == &original? 0 : 1);
+    if (newFrames.isEmpty()) {
         QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
                                  tr("Cannot load %1: %2")
-                                 .arg(QDir::toNativeSeparators(fileName), reader.errorString()));
+                                 .arg(QDir::toNativeSeparators(fileName), error));
         return false;
     }
 
+	const QImage & newImage = newFrames.first();
+
 	if(!other->isNull())
 	{
 		if(newImage.size() != other->size())
@@ -569,39 +1173,453 @@ bool MainWindow::openFile(QImage * image, QImage *other, const QString &fileName
 		}
 	}
 
-	*image = std::move(newImage);
+	if(image == &original)
+	{
+		setFrames(newFrames);
+		baseSource = key;
+		setDocumentTitle(fileName);
+	}
+	else
+	{
+		*image = original.isNull()? newImage : newImage.convertToFormat(original.format());
+		if(image == &modifier) modifierSource = key;
+	}
+
+	invalidateSource();
 	if(image == &original) reset();
 
+//the frames are counted as sources now, the reservation ends with this scope
+	updateMemoryStatus();
 	return true;
 }
 
+//the first frame within bound; formats like JPEG decode straight to the smaller size
+static QVector<QImage> decodePreview(const QString & fileName, const QSize & bound)
+{
+	QImageReader reader(fileName);
+	reader.setAutoTransform(true);
+	reader.setScaledSize(reader.size().scaled(bound, Qt::KeepAspectRatio));
+	reader.setQuality(25);
+
+	QImage image = reader.read();
+
+	if(image.isNull())
+	{
+		return QVector<QImage>();
+	}
+
+	return QVector<QImage>() << image.convertToFormat(QImage::Format_ARGB32);
+}
+
+//shows a decode scaled to the view first, the full decode replaces it once it is ready
+void MainWindow::openDeferred(const QString & base, const QString & other)
+{
+	if(loadWatcher.isRunning())
+	{
+		return;
+	}
+
+	loadingBase     = base;
+	loadingModifier = other;
+
+	const QSize  full  = QImageReader(base).size();
+	const QSize  bound = ui->widget->size();
+	const qint64 bytes = ImageSequence::decodedBytes(base);
+
+	loadMemory.set(0);
+
+	if(bytes && !reserveMemory(loadMemory, bytes))
+	{
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot load %1: it does not fit the memory budget").arg(QDir::toNativeSeparators(base)));
+		return;
+	}
+
+	loadingFull = !full.isValid() || (full.width() <= bound.width() && full.height() <= bound.height());
+
+	setLoading(true);
+	statusBar()->showMessage(tr("Loading %1...").arg(QDir::toNativeSeparators(base)));
+
+	if(loadingFull)
+	{
+		loadWatcher.setFuture(QtConcurrent::run([base]() { return ImageSequence::read(base); }));
+	}
+	else
+	{
+		loadWatcher.setFuture(QtConcurrent::run([base, bound]() { return decodePreview(base, bound); }));
+	}
+
+	updateBusy();
+}
+
+void MainWindow::loaded()
+{
+	const QVector<QImage> images = loadWatcher.result();
+
+	if(!loadingFull)
+	{
+		Timeline::mark("preview decoded");
+
+		if(!images.isEmpty())
+		{
+			baseSource.clear();
+			setFrames(images);
+			invalidateSource();
+			reset();
+			paintMark = "preview painted";
+		}
+
+		const QString base = loadingBase;
+		loadingFull = true;
+		loadWatcher.setFuture(QtConcurrent::run([base]() { return ImageSequence::read(base); }));
+		return;
+	}
+
+	Timeline::mark("full image decoded");
+
+	setLoading(false);
+	statusBar()->clearMessage();
+
+	if(images.isEmpty())
+	{
+		loadMemory.set(0);
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot load %1").arg(QDir::toNativeSeparators(loadingBase)));
+		clearDocument();
+		return;
+	}
+
+//keep the preview's on-screen size so the swap is seamless
+	const double scale = original.isNull()? 1.0 : (double) original.width() / images.first().width();
+
+	setFrames(images);
+	modifier = QImage();
+	extraModifiers.clear();
+	baseSource = sourceKey(loadingBase);
+	modifierSource.clear();
+	setDocumentTitle(loadingBase);
+	invalidateSource();
+	reset();
+	setZoom(scale);
+	paintMark = "full image painted";
+
+	updateMemoryStatus();
+	loadMemory.set(0);
+
+	if(!loadingModifier.isEmpty())
+	{
+		openFile(&modifier, &original, loadingModifier);
+	}
+}
+
+//edits and document changes wait while a file or the clipboard is decoded in the background
+void MainWindow::setLoading(bool loading)
+{
+	ui->menuEdit->setEnabled(!loading);
+	ui->actionSave->setEnabled(!loading);
+	ui->actionSave_As->setEnabled(!loading);
+	ui->actionNew->setEnabled(!loading);
+	ui->actionClose->setEnabled(!loading);
+	ui->tabBar->setEnabled(!loading);
+	updateBusy();
+}
+
+void MainWindow::updateBusy()
+{
+	busyBar->setVisible(loadWatcher.isRunning() || pasteWatcher.isRunning() || copyWatcher.isRunning());
+}
+
+//the caller invalidates the source; the frame list only shows with more than one frame
+void MainWindow::setFrames(const QVector<QImage> & frames, int current)
+{
+	this->frames = frames;
+	currentFrame = frames.isEmpty()? 0 : current;
+	original = frames.isEmpty()? QImage() : frames[currentFrame];
+
+//the matrix kernels only read a modifier in the same format as the base
+	if(!original.isNull() && !modifier.isNull() && modifier.format() != original.format())
+	{
+		modifier = modifier.convertToFormat(original.format());
+	}
+
+	for(QImage & it : extraModifiers)
+	{
+		if(!original.isNull() && it.format() != original.format())
+			it = it.convertToFormat(original.format());
+	}
+	frameThumbnails = frames.size() > 1? ImageSequence::thumbnails(frames, thumbnailSize) : QVector<QImage>();
+	thumbnailKey.clear();
+
+	frameList->blockSignals(true);
+	frameList->clear();
+
+	for(int i = 0; i < frameThumbnails.size(); ++i)
+	{
+		frameList->addItem(new QListWidgetItem(QIcon(QPixmap::fromImage(frameThumbnails[i])), tr("Frame %1").arg(i+1)));
+	}
+
+	frameList->setCurrentRow(currentFrame);
+	frameList->blockSignals(false);
+	frameDock->setVisible(frames.size() > 1);
+}
+
+//the transform carries over to the new frame
+void MainWindow::showFrame(int index)
+{
+	if(index < 0 || index >= frames.size() || index == currentFrame)
+	{
+		return;
+	}
+
+	const RenderKind kind = renderKind;
+
+	currentFrame = index;
+	original = frames[index];
+	invalidateSource();
+	adoptParams(params(kind));
+	updateScrollBars();
+}
+
+//thumbnails follow the chosen tier, and are left alone while a slider is dragged
+void MainWindow::updateThumbnails()
+{
+	if(frameThumbnails.isEmpty() || dragging)
+	{
+		return;
+	}
+
+	const QByteArray key = renderKey(renderKind);
+
+	if(key == thumbnailKey)
+	{
+		return;
+	}
+
+	thumbnailKey = key;
+	Scheduler::Scope scope(Scheduler::PriorityBulk);
+
+	QVector<QImage> shrunk;
+
+	for(const QImage & it : modifierList())
+	{
+		shrunk << (it.size() == original.size()? ImageSequence::thumbnails(QVector<QImage>() << it, thumbnailSize).first() : QImage());
+	}
+
+	const QVector<QImage> icons = ImageSequence::render(frameThumbnails, shrunk, params(renderKind), quality);
+
+	for(int i = 0; i < icons.size() && i < frameList->count(); ++i)
+	{
+		frameList->item(i)->setIcon(QIcon(QPixmap::fromImage(icons[i])));
+	}
+}
+
 void MainWindow::documentNew()
 {
-	documentClose();
+	Document document;
+	document.currentFrame = 0;
+	document.params = ImageTransform::defaultParams();
+	document.generation = nextGeneration++;
+	document.zoom = 1.0;
+
+	documents.push_back(document);
+	ui->tabBar->setCurrentIndex(ui->tabBar->addTab(tr("Untitled")));
 }
 
 void MainWindow::documentClose()
+{
+	closeDocument(activeDocument);
+}
+
+void MainWindow::clearDocument()
 {
 	filename = QString();
-	original = QImage();
+	baseSource.clear();
+	modifierSource.clear();
+	setFrames(QVector<QImage>());
 	modifier = QImage();
+	extraModifiers.clear();
 	render = QImage();
+	invalidateSource();
+	setDocumentTitle(QString());
 	reset();
 }
 
-bool MainWindow::saveFile(const QString &fileName)
+//the last tab is emptied instead of closed
+void MainWindow::closeDocument(int index)
 {
-    QImageWriter writer(fileName);
+	if(index < 0 || index >= documents.size() || loadWatcher.isRunning())
+	{
+		return;
+	}
 
-    if (!writer.write(render)) {
-        QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
-                                 tr("Cannot write %1: %2")
-                                 .arg(QDir::toNativeSeparators(fileName)), writer.errorString());
-        return false;
-    }
-    const QString message = tr("Wrote \"%1\"").arg(QDir::toNativeSeparators(fileName));
-    statusBar()->showMessage(message);
-    return true;
+	if(documents.size() == 1)
+	{
+		clearDocument();
+		return;
+	}
+
+	dropRenders(index == activeDocument? generation : documents[index].generation);
+
+//removeTab() moves the current tab, activateDocument() then has nothing to stash or is already there
+	if(index == activeDocument)
+		activeDocument = -1;
+	else if(index < activeDocument)
+		--activeDocument;
+
+	documents.remove(index);
+	ui->tabBar->removeTab(index);
+	updateMemoryStatus();
+}
+
+void MainWindow::activateDocument(int index)
+{
+	if(index < 0 || index >= documents.size() || index == activeDocument)
+	{
+		return;
+	}
+
+	if(activeDocument >= 0)
+	{
+		stashDocument();
+	}
+
+	activeDocument = index;
+	restoreDocument();
+}
+
+//inactive documents keep their sources and parameters, their renders only live on in the shared cache
+void MainWindow::stashDocument()
+{
+	Document & document = documents[activeDocument];
+	document.filename       = filename;
+	document.baseSource     = baseSource;
+	document.modifierSource = modifierSource;
+	document.frames         = frames;
+	document.currentFrame   = currentFrame;
+	document.modifier       = modifier;
+	document.extraModifiers = extraModifiers;
+	document.params         = params(renderKind);
+	document.generation     = generation;
+	document.zoom           = zoom;
+	document.scrollPosition = scrollPosition;
+}
+
+//nothing renders in the background, a tab's render is fetched from the cache or redone once it is shown
+void MainWindow::restoreDocument()
+{
+	const Document document = documents[activeDocument];
+	filename       = document.filename;
+	baseSource     = document.baseSource;
+	modifierSource = document.modifierSource;
+	modifier       = document.modifier;
+	extraModifiers = document.extraModifiers;
+	setFrames(document.frames, document.currentFrame);
+
+	generation = document.generation;
+	renderKind = RenderNone;
+	renderGeneration = 0;
+	pigmentSwap = std::vector<Vector3>();
+	pigmentSwapGeneration = 0;
+	++lazyRevision;
+	tiles.clear();
+	zoom = document.zoom;
+
+	if(document.params.kind == RenderNone)
+	{
+		ImageTransform::measure(original, renderStats);
+		histogramView->setStats(renderStats);
+	}
+
+	adoptParams(document.params);
+	updateScrollBars();
+
+	ui->horizontalScrollBar->blockSignals(true);
+	ui->verticalScrollBar->blockSignals(true);
+	ui->horizontalScrollBar->setValue(document.scrollPosition.x());
+	ui->verticalScrollBar->setValue(document.scrollPosition.y());
+	ui->horizontalScrollBar->blockSignals(false);
+	ui->verticalScrollBar->blockSignals(false);
+
+	scrollPosition = QPoint(ui->horizontalScrollBar->value(), ui->verticalScrollBar->value());
+	ui->widget->update();
+	updateMemoryStatus();
+}
+
+void MainWindow::setDocumentTitle(const QString & fileName)
+{
+	ui->tabBar->setTabText(activeDocument, fileName.isEmpty()? tr("Untitled") : QFileInfo(fileName).fileName());
+	ui->tabBar->setTabToolTip(activeDocument, QDir::toNativeSeparators(fileName));
+}
+
+//renders and writes on the pool as bulk work, so editing can go on meanwhile; the images are shared copy-on-write
+bool MainWindow::saveFile(const QString &fileName, bool saveAs)
+{
+	if(saveWatcher.isRunning())
+	{
+		statusBar()->showMessage(tr("Still writing \"%1\"").arg(QDir::toNativeSeparators(savingName)));
+		return false;
+	}
+
+	const QVector<QImage>  sources  = frames;
+	const QVector<QImage>  others   = modifierList();
+	const TransformParams  current  = params(renderKind);
+	const Quality          tier     = quality;
+	const QImage           rendered = frames.size() > 1? QImage() : render;
+
+//the other frames are rendered for the save alone
+	qint64 bytes = 0;
+	if(rendered.isNull()) for(const QImage & it : sources) bytes += it.byteCount();
+
+	saveMemory.set(0);
+
+	if(!reserveMemory(saveMemory, bytes))
+	{
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot write %1: it does not fit the memory budget").arg(QDir::toNativeSeparators(fileName)));
+		return false;
+	}
+
+	savingName = fileName;
+	savingAs   = saveAs;
+	statusBar()->showMessage(tr("Writing \"%1\"...").arg(QDir::toNativeSeparators(fileName)));
+
+	saveWatcher.setFuture(Scheduler::run<QString>(Scheduler::PriorityBulk, [fileName, sources, others, current, tier, rendered]()
+	{
+		QVector<QImage> renders;
+		QString error;
+
+//the other frames go through the same transform from the frames already decoded for the view
+		if(rendered.isNull() && !sources.isEmpty())
+			renders = ImageSequence::render(sources, others, current, tier);
+		else
+			renders << rendered;
+
+		return ImageSequence::write(fileName, renders, &error)? QString() : error;
+	}));
+
+	return true;
+}
+
+void MainWindow::saved()
+{
+	const QString error = saveWatcher.result();
+	saveMemory.set(0);
+
+	if(!error.isNull())
+	{
+		statusBar()->clearMessage();
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot write %1: %2")
+								 .arg(QDir::toNativeSeparators(savingName), error));
+
+		if(savingAs)
+		{
+			documentSaveAs();
+		}
+		return;
+	}
+
+	statusBar()->showMessage(tr("Wrote \"%1\"").arg(QDir::toNativeSeparators(savingName)));
 }
 
 void MainWindow::editMatrix()
@@ -625,59 +1643,345 @@ void MainWindow::editPigments()
 	dialog.exec();
 }
 
+void MainWindow::editHSV()
+{
+	HSVEditor dialog(this);
+	dialog.show();
+	dialog.exec();
+}
+
+void MainWindow::saveParams()
+{
+	QString name = QFileDialog::getSaveFileName(this, tr("Save Parameters"), QString(), tr("Parameters (*.json)"));
 
+	if(name.isEmpty())
+	{
+		return;
+	}
+
+	QFile file(name);
+
+	if(!file.open(QIODevice::WriteOnly) || file.write(QJsonDocument(ImageTransform::paramsToJson(params(renderKind))).toJson()) < 0)
+	{
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot write %1: %2").arg(QDir::toNativeSeparators(name), file.errorString()));
+	}
+}
+
+void MainWindow::loadParams()
+{
+	QString name = QFileDialog::getOpenFileName(this, tr("Load Parameters"), QString(), tr("Parameters (*.json)"));
+
+	if(name.isEmpty())
+	{
+		return;
+	}
+
+	QFile file(name);
+
+	if(!file.open(QIODevice::ReadOnly))
+	{
+		QMessageBox::information(this, QGuiApplication::applicationDisplayName(),
+								 tr("Cannot load %1: %2").arg(QDir::toNativeSeparators(name), file.errorString()));
+		return;
+	}
+
+	adoptParams(ImageTransform::paramsFromJson(QJsonDocument::fromJson(file.readAll()).object()));
+}
+
+void MainWindow::exportSweep()
+{
+	SweepDialog dialog(this);
+	dialog.show();
+	dialog.exec();
+}
+
+void MainWindow::compareParams()
+{
+	ComparisonDialog dialog(this);
+	dialog.show();
+	dialog.exec();
+}
+
+void MainWindow::fitExample()
+{
+	if(original.isNull())
+	{
+		return;
+	}
+
+	FitDialog dialog(this);
+	dialog.show();
+
+	if(dialog.exec() != QDialog::Accepted)
+	{
+		return;
+	}
+
+	ExampleFit::Result result = dialog.result();
+	adoptParams(result.params);
+
+	statusBar()->showMessage(tr("Fit residual: %1 RMS (r %2, g %3, b %4)")
+							 .arg(result.error(), 0, 'f', 2)
+							 .arg(result.rms[0], 0, 'f', 2).arg(result.rms[1], 0, 'f', 2).arg(result.rms[2], 0, 'f', 2));
+
+//open the fitted values in their editor for fine tuning
+	if(result.params.kind == RenderMatrix)
+	{
+		editMatrix();
+	}
+	else
+	{
+		editPigments();
+	}
+}
+
+//the clipboard gets the render by reference, nothing is encoded unless another application pastes it
 void MainWindow::editCopy()
 {
-	#ifndef QT_NO_CLIPBOARD
-	QGuiApplication::clipboard()->setImage(render);
-	#endif // !QT_NO_CLIPBOARD
+#ifndef QT_NO_CLIPBOARD
+	if(original.isNull())
+	{
+		statusBar()->showMessage(tr("Nothing to copy"));
+		return;
+	}
+
+	if(!render.isNull())
+	{
+		QGuiApplication::clipboard()->setMimeData(new ImageMimeData(render));
+	}
+	else
+	{
+//lazy mode keeps no full render, one is made in the background in case something pastes it
+		const QImage          source  = original;
+		const QVector<QImage> others  = modifierList();
+		const TransformParams current = lazyParams;
+		const Quality         tier    = quality;
+
+//the clipboard data takes the count over once it holds the render
+		MemoryAccountant::Account reserved(MemoryAccountant::CategoryRenders);
+
+		if(!reserveMemory(reserved, original.byteCount()))
+		{
+			statusBar()->showMessage(tr("Memory budget reached, nothing copied"));
+			return;
+		}
+
+		copyWatcher.setFuture(Scheduler::run<QImage>(Scheduler::PriorityBulk, [source, others, current, tier]()
+		{
+			return ImageTransform::render(source, others, current, nullptr, nullptr, 0, tier);
+		}));
+
+		QGuiApplication::clipboard()->setMimeData(new ImageMimeData(copyWatcher.future(), original.byteCount()));
+		updateBusy();
+	}
+
+	statusBar()->showMessage(tr("Copied %1x%2 render").arg(original.width()).arg(original.height()));
+#endif // !QT_NO_CLIPBOARD
 }
 
 #ifndef QT_NO_CLIPBOARD
-static QImage clipboardImage()
-{
-    if (const QMimeData *mimeData = QGuiApplication::clipboard()->mimeData()) {
-        if (mimeData->hasImage()) {
-            const QImage image = qvariant_cast<QImage>(mimeData->imageData());
-            if (!image.isNull())
-                return image;
-        }
-    }
-    return QImage();
+//the encoded format to fetch from other applications, lossless ones first; the reader tells it from the contents
+static QString clipboardFormat(const QMimeData * mimeData)
+{
+	const QStringList     available = mimeData->formats();
+	const QByteArrayList  supported = QImageReader::supportedMimeTypes();
+
+	for(const char * preferred : {"image/png", "image/tiff", "image/bmp"})
+	{
+		if(available.contains(preferred) && supported.contains(preferred))
+			return preferred;
+	}
+
+	for(const QString & it : available)
+	{
+		if(supported.contains(it.toLatin1()))
+			return it;
+	}
+
+	return QString();
 }
 #endif // !QT_NO_CLIPBOARD
 
+//only the transfer happens here, decoding and conversion to the working format run on the pool like a file's
 void MainWindow::editPaste()
 {
 #ifndef QT_NO_CLIPBOARD
-    QImage newImage = clipboardImage();
-    if (newImage.isNull()) {
-        statusBar()->showMessage(tr("No image in clipboard"));
-    } else {
-		original = std::move(newImage);
-		render = original;
-		filename = QString();
-		reset();
-
-        const QString message = tr("Obtained image from clipboard, %1x%2, Depth: %3")
-            .arg(newImage.width()).arg(newImage.height()).arg(newImage.depth());
-        statusBar()->showMessage(message);
-    }
+	const QMimeData * mimeData = QGuiApplication::clipboard()->mimeData();
+
+	if(pasteWatcher.isRunning() || loadWatcher.isRunning() || mimeData == nullptr)
+	{
+		return;
+	}
+
+	const ImageMimeData * own = qobject_cast<const ImageMimeData *>(mimeData);
+
+	const QString format  = own? QString() : clipboardFormat(mimeData);
+	const QByteArray encoded = format.isEmpty()? QByteArray() : mimeData->data(format);
+	QImage image;
+	QFuture<QImage> copied;
+
+//our own copy may still be rendering, the worker waits for it; platforms that only offer a native bitmap come decoded already
+	if(own)
+	{
+		image  = own->rendered();
+		copied = own->pending();
+	}
+	else if(encoded.isEmpty() && mimeData->hasImage())
+	{
+		image = qvariant_cast<QImage>(mimeData->imageData());
+	}
+
+	if(encoded.isEmpty() && image.isNull() && copied.isCanceled())
+	{
+		statusBar()->showMessage(tr("No image in clipboard"));
+		return;
+	}
+
+//the pasted frames in the working format, from the encoded header or the copy they come from
+	QBuffer header;
+	header.setData(encoded);
+	header.open(QIODevice::ReadOnly);
+	const qint64 bytes = !encoded.isEmpty()? ImageSequence::decodedBytes(&header) : image.isNull()? original.byteCount() : image.byteCount();
+
+	loadMemory.set(0);
+
+	if(!reserveMemory(loadMemory, bytes))
+	{
+		statusBar()->showMessage(tr("Memory budget reached, nothing pasted"));
+		return;
+	}
+
+	setLoading(true);
+	statusBar()->showMessage(tr("Pasting..."));
+
+	pasteWatcher.setFuture(Scheduler::run<QVector<QImage> >(Scheduler::PriorityRefine, [encoded, image, copied]()
+	{
+		QVector<QImage> frames;
+
+		if(encoded.isEmpty())
+		{
+//the copy render queues on the same pool, its thread is handed back while waiting so the render can start
+			QImage pasted = image;
+
+			if(pasted.isNull())
+			{
+				QThreadPool::globalInstance()->releaseThread();
+				pasted = copied.result();
+				QThreadPool::globalInstance()->reserveThread();
+			}
+
+			frames << pasted;
+			ImageSequence::normalize(frames);
+			return frames;
+		}
+
+		QBuffer buffer;
+		buffer.setData(encoded);
+		buffer.open(QIODevice::ReadOnly);
+		return ImageSequence::read(&buffer);
+	}));
+
+	updateBusy();
 #endif // !QT_NO_CLIPBOARD
 }
 
-void MainWindow::draw(QPainter & painter, QSize size)
+void MainWindow::pasted()
 {
-	if(render.isNull()) return;
+	const QVector<QImage> images = pasteWatcher.result();
+	setLoading(false);
+
+	if(images.isEmpty())
+	{
+		loadMemory.set(0);
+		statusBar()->showMessage(tr("Cannot read the image in the clipboard"));
+		return;
+	}
 
-	painter.scale(zoom, zoom);
-	size /= zoom;
+	setFrames(images);
+	invalidateSource();
+	filename = QString();
+	baseSource.clear();
+	setDocumentTitle(QString());
+	reset();
+
+	updateMemoryStatus();
+	loadMemory.set(0);
+
+	statusBar()->showMessage(tr("Obtained image from clipboard, %1x%2, Depth: %3")
+		.arg(original.width()).arg(original.height()).arg(original.depth()));
+}
+
+QPoint MainWindow::scrollOffset() const
+{
+	return scrollPosition;
+}
 
-	QSize s0 = render.size() - size;
-	QPoint offset(ui->horizontalScrollBar->value() * s0.width () / 255,
-				  ui->verticalScrollBar  ->value() * s0.height() / 255);
+void MainWindow::setZoom(double zoom)
+{
+	SessionRecorder::recordZoom(zoom);
+	this->zoom = zoom;
+	updateScrollBars();
+	ui->widget->repaint();
+}
 
-	painter.drawImage(0, 0, render, offset.x(), offset.y(), size.width(), size.height());
+//scroll bars are in view pixels of the zoomed image, so panning is pixel precise
+void MainWindow::updateScrollBars()
+{
+	const QSize content = original.size() * zoom;
+	const QSize view    = ui->widget->size();
+
+	clampingScroll = true;
+
+	ui->horizontalScrollBar->setRange(0, std::max(0, content.width() - view.width()));
+	ui->horizontalScrollBar->setPageStep(std::max(1, view.width()));
+	ui->horizontalScrollBar->setSingleStep(32);
+
+	ui->verticalScrollBar->setRange(0, std::max(0, content.height() - view.height()));
+	ui->verticalScrollBar->setPageStep(std::max(1, view.height()));
+	ui->verticalScrollBar->setSingleStep(32);
+
+	clampingScroll = false;
+}
+
+//shifts what is already on screen and only repaints the strip that was exposed
+void MainWindow::scrolled()
+{
+	QPoint position(ui->horizontalScrollBar->value(), ui->verticalScrollBar->value());
+	QPoint delta = position - scrollPosition;
+	scrollPosition = position;
+	if(!clampingScroll) SessionRecorder::recordScroll(position);
+
+	ui->widget->scroll(-delta.x(), -delta.y());
+}
+
+void MainWindow::draw(QPainter & painter, const QRect & exposed)
+{
+	if(lazyRender && render.isNull())
+	{
+//keys below zero never clash with QImage::cacheKey()
+		tiles.draw(painter, exposed, original.size(), -(qint64) lazyRevision, [this](const QRect & source, const QSize & size)
+		{
+			return renderRegion(source, size);
+		}, zoom, scrollPosition);
+	}
+	else
+	{
+		tiles.draw(painter, exposed, render, zoom, scrollPosition);
+	}
+
+//tiles are made and evicted while drawing, the recount waits for the timer
+	if(tiles.cost() != paintedTileCost)
+	{
+		paintedTileCost = tiles.cost();
+		memoryChanged();
+	}
+
+	if(paintMark)
+	{
+		Timeline::mark(paintMark);
+		paintMark = nullptr;
+	}
 }
 
 bool MainWindow::event(QEvent * event)
@@ -711,8 +2015,7 @@ bool MainWindow::event(QEvent * event)
 			{
 				double angle = wheel->angleDelta().y();
 				double factor = std::pow(1.0015, angle);
-				zoom *= factor;
-				ui->widget->repaint();
+				setZoom(zoom * factor);
 			}
 		}
 		else if(wheel->buttons() != Qt::MidButton)
@@ -2,6 +2,16 @@
 #define MAINWINDOW_H
 #include <QMainWindow>
 #include <QImage>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QTimer>
+#include <QVector>
+#include <vector>
+#include "colortransform.h"
+#include "tilestore.h"
+#include "scheduler.h"
+#include "memoryaccountant.h"
+#include "sessionrecorder.h"
 
 namespace Ui {
 class MainWindow;
@@ -9,10 +19,11 @@ class MainWindow;
 
 class MatrixEditor;
 class RotationEditor;
-
-#define MATRIX_ROWS 3
-#define MATRIX_COLS 5
-#define MATRIX_SIZE (MATRIX_ROWS*MATRIX_COLS)
+class HistogramView;
+class QLabel;
+class QListWidget;
+class QDockWidget;
+class QProgressBar;
 
 class MainWindow : public QMainWindow
 {
@@ -20,6 +31,10 @@ typedef QMainWindow super;
 friend class MatrixEditor;
 friend class RotationEditor;
 friend class PigmentEditor;
+friend class HSVEditor;
+friend class SweepDialog;
+friend class ComparisonDialog;
+friend class FitDialog;
 	Q_OBJECT
 
 public:
@@ -27,51 +42,243 @@ public:
 	~MainWindow();
 
 
-	void draw(QPainter & painter, QSize size);
+	void draw(QPainter & painter, const QRect & exposed);
 	bool event(QEvent * event) Q_DECL_OVERRIDE;
 
+	QPoint scrollOffset() const;
+	void   updateScrollBars();
+
 	uint8_t matrix[MATRIX_SIZE];
 	uint8_t angles[3];
 	uint8_t pigments[6];
+	uint8_t hsv[3];
+	bool    linear;
+
+//0 for the classic matrix, otherwise the wide one and the modifier channel of each of its columns, see TransformParams
+	uint8_t modifierCount;
+	uint8_t modifierChannel[MODIFIER_CHANNELS];
+	uint8_t wide[WIDE_SIZE];
 
 	static float applyPigment(float color, float pigment);
 
+	TransformParams params(RenderKind kind) const;
+	void adoptParams(const TransformParams & params);
+
+//the modifier, then the ones added after it, in the order the wide matrix numbers them
+	QVector<QImage> modifierList() const;
+
+	void openDeferred(const QString & base, const QString & modifier = QString());
+	void setDragging(bool dragging);
+
+//for --replay: opens the base now, and applies a recorded input the way the editor or view it came from did
+	bool openImage(const QString & fileName);
+	void replay(const SessionRecorder::Event & event);
+
 private:
 	void reset();
 
+	void setZoom(double zoom);
+	void scrolled();
+
 	void documentNew();
 	void documentClose();
+	void clearDocument();
+	void closeDocument(int index);
+	void activateDocument(int index);
+	void stashDocument();
+	void restoreDocument();
+	void setDocumentTitle(const QString & fileName);
+	void dropRenders(uint32_t generation);
 
 	void documentOpenOriginal();
 	void documentOpenModifier();
+	void documentAddModifier();
 	void documentSave();
 	void documentSaveAs();
 
 	void editCopy();
 	void editPaste();
+	void pasted();
 
 	void editMatrix();
 	void editAngles();
 	void editPigments();
+	void editHSV();
+
+	void saveParams();
+	void loadParams();
+
+	void exportSweep();
+	void compareParams();
+	void fitExample();
 
 	void applyMatrix();
 	void applyAngles();
 	void applyPigments();
+	void applyHSV();
+	void swapPigments();
 
 	void onNegate();
 
+	void invalidateSource();
+	bool beginRender(RenderKind kind);
+	bool rendersInPlace(RenderKind kind) const;
+
+	Quality activeQuality() const;
+	Scheduler::Priority renderPriority() const;
+	void    setQuality(Quality quality);
+	void    setLinear(bool linear);
+
+	bool   deferRender(RenderKind kind);
+	void   setLazyRender(bool enabled);
+	QImage renderRegion(const QRect & source, const QSize & size) const;
+	void   dropFullRenders();
+	void   updateMemoryStatus();
+	void   memoryChanged();
+	bool   reserveMemory(MemoryAccountant::Account & account, qint64 bytes);
+	void   addEvictors();
+
+	QByteArray renderKey(RenderKind kind) const;
+	bool fetchRender(RenderKind kind);
+	void storeRender();
+	void finishRender();
+
+	void loaded();
+	void setLoading(bool loading);
+	void updateBusy();
+
+	void setFrames(const QVector<QImage> & frames, int current = 0);
+	void showFrame(int index);
+	void updateThumbnails();
+
+	QVector<QImage> sharedSource(const QString & key, bool base) const;
 	bool openFile(QImage *slot, QImage * other, const QString & filename);
-	bool saveFile(const QString & filename);
+	bool saveFile(const QString & filename, bool saveAs = false);
+	void saved();
 
 
 
 	QString filename;
 
+//files the base and modifier were decoded from, for sharing them between documents; empty when pasted or closed
+	QString baseSource;
+	QString modifierSource;
+
+//what a tab keeps while another one is active; the images share their pixels with any other document using the same file
+	struct Document
+	{
+		QString         filename;
+		QString         baseSource;
+		QString         modifierSource;
+		QVector<QImage> frames;
+		int             currentFrame;
+		QImage          modifier;
+		QVector<QImage> extraModifiers;
+		TransformParams params;
+		uint32_t        generation;
+		double          zoom;
+		QPoint          scrollPosition;
+	};
+
+//the active document lives in the members of this class, its entry is only brought up to date when switching away
+	QVector<Document> documents;
+	int               activeDocument;
+
 	QImage original;
 	QImage modifier;
+
+//modifiers past the first, only read by the wide matrix; always the size and format of original
+	QVector<QImage> extraModifiers;
+
+//every frame or page of the base file, original shares the pixels of frames[currentFrame]
+	QVector<QImage> frames;
+	int             currentFrame;
+	QVector<QImage> frameThumbnails;
+	QByteArray      thumbnailKey;
+	QListWidget   * frameList;
+	QDockWidget   * frameDock;
 	QImage render;
 
+//what produced render, so edits only recompute the channels they touch
+	RenderKind renderKind;
+	uint32_t   generation;
+	uint32_t   nextGeneration;
+	uint32_t   renderGeneration;
+	uint8_t    renderMatrix[MATRIX_SIZE];
+	uint8_t    renderWide[WIDE_SIZE];
+	uint8_t    renderModifierCount;
+	uint8_t    renderModifierChannel[MODIFIER_CHANNELS];
+	uint8_t    renderAngles[3];
+	uint8_t    renderPigments[6];
+	uint8_t    renderHSV[3];
+	Quality    renderQuality;
+	bool       renderLinear;
+	RenderStats renderStats;
+
+	struct CachedRender
+	{
+		QImage      image;
+		RenderStats stats;
+	};
+
+//finished renders of every document keyed by generation, transform and parameters; cost is in KiB
+	QCache<QByteArray, CachedRender> renderCache;
+
+//output of the pigment swap stage, only depends on pigments[3..5]
+	std::vector<Vector3> pigmentSwap;
+	uint32_t pigmentSwapGeneration;
+	uint8_t  pigmentSwapParams[3];
+
+//lazy mode keeps no full size render, only the parameters and the tiles in view
+	bool            lazyRender;
+	TransformParams lazyParams;
+	uint32_t        lazyRevision;
+
+//quality is the chosen tier, previews replace it while an editor slider is dragged
+	Quality quality;
+	bool    previewDrags;
+	bool    dragging;
+
 	double zoom;
+	QPoint scrollPosition;
+//set while a new range clamps the scroll bars, the scroll that follows is not an input
+	bool   clampingScroll;
+	TileStore tiles;
+	QLabel * memoryLabel;
+
+//this window's buffers in the memory accountant, brought up to date by updateMemoryStatus() right after loads and
+//document switches, and a little after renders and tile changes so that bursts of them recount only once
+	QTimer memoryTimer;
+	int    paintedTileCost;
+	MemoryAccountant::Account sourceMemory;
+	MemoryAccountant::Account renderMemory;
+	MemoryAccountant::Account cacheMemory;
+	MemoryAccountant::Account tileMemory;
+	MemoryAccountant::Account scratchMemory;
+//a full size render reserved before it is allocated, until updateMemoryStatus() counts the render itself
+	MemoryAccountant::Account reservedRender;
+//the frames openDeferred() or a paste decodes, until they are in place
+	MemoryAccountant::Account loadMemory;
+
+//decoding for openDeferred, a reduced scale preview and then every frame at full size
+	QFutureWatcher<QVector<QImage> > loadWatcher;
+	QString      loadingBase;
+	QString      loadingModifier;
+	bool         loadingFull;
+	const char * paintMark;
+
+//clipboard work in the background, with an indefinite progress bar while any of it runs
+	QFutureWatcher<QVector<QImage> > pasteWatcher;
+	QFutureWatcher<QImage>           copyWatcher;
+	QProgressBar                   * busyBar;
+
+//saveFile() runs in the background, one file at a time; a failed Save As asks for another name once it is known
+	QFutureWatcher<QString>   saveWatcher;
+	QString                   savingName;
+	bool                      savingAs;
+	MemoryAccountant::Account saveMemory;
+
+	HistogramView * histogramView;
 	Ui::MainWindow *ui;
 };
 
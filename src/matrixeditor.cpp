@@ -3,6 +3,13 @@
 #include "ui_mainwindow.h"
 
 #include "mainwindow.h"
+#include "imagetransform.h"
+#include <QComboBox>
+#include <QLabel>
+#include <QSpinBox>
+#include <algorithm>
+
+static const char * const channelNames[] = { QT_TR_NOOP("Red"), QT_TR_NOOP("Green"), QT_TR_NOOP("Blue"), QT_TR_NOOP("Alpha") };
 
 MatrixEditor::MatrixEditor(MainWindow * window, QWidget *parent) :
 QDialog(parent),
@@ -11,30 +18,12 @@ ui(new Ui::MatrixEditor)
 {
 	ui->setupUi(this);
 
-	memcpy(originalMatrix, window->matrix, sizeof(window->matrix));
-
-	spinBox[0] = ui->spinBox;
-	spinBox[1] = ui->spinBox_2;
-	spinBox[2] = ui->spinBox_3;
-	spinBox[3] = ui->spinBox_4;
-	spinBox[4] = ui->spinBox_5;
-	spinBox[5] = ui->spinBox_6;
-	spinBox[6] = ui->spinBox_7;
-	spinBox[7] = ui->spinBox_8;
-	spinBox[8] = ui->spinBox_9;
-	spinBox[9] = ui->spinBox_10;
-	spinBox[10] = ui->spinBox_11;
-	spinBox[11] = ui->spinBox_12;
-	spinBox[12] = ui->spinBox_13;
-	spinBox[13] = ui->spinBox_14;
-	spinBox[14] = ui->spinBox_15;
-
-	for(size_t i = 0; i < spinBox.size(); ++i)
-	{
-		spinBox[i]->setValue(window->matrix[i]);
-		connect(spinBox[i], SIGNAL(valueChanged(int)), this, SLOT(updateMatrixDisplay(int)));
-	}
+	originalParams = window->params(RenderMatrix);
 
+	ui->columnBox->setValue(window->modifierCount);
+	rebuild();
+
+	connect(ui->columnBox, SIGNAL(valueChanged(int)), this, SLOT(setColumns(int)));
 	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &MatrixEditor::accepted);
 	connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &MatrixEditor::rejected);
 
@@ -53,19 +42,112 @@ void MatrixEditor::accepted()
 
 void MatrixEditor::rejected()
 {
-	memcpy(window->matrix, originalMatrix, sizeof(window->matrix));
-	window->applyMatrix();
-	window->ui->widget->repaint();
+	window->adoptParams(originalParams);
 	reject();
 }
 
+//the grid follows the width: the classic matrix keeps its two fixed modifier columns, the wide one has a source per column
+void MatrixEditor::rebuild()
+{
+	qDeleteAll(cells);
+	cells.clear();
+	spinBox.clear();
+	sourceBox.clear();
+
+	const int       count   = window->modifierCount;
+	const int       cols    = count? 3 + count : MATRIX_COLS;
+	const int       stride  = count? WIDE_COLS : MATRIX_COLS;
+	const uint8_t * weights = count? window->wide : window->matrix;
+
+//every channel of the loaded modifiers, and of any a loaded parameter file refers to
+	int modifiers = std::max(1, window->modifierList().size());
+
+	for(int i = 0; i < count; ++i)
+	{
+		modifiers = std::max(modifiers, window->modifierChannel[i] / 4 + 1);
+	}
+
+	for(int x = 0; x < cols; ++x)
+	{
+		QWidget * header;
+
+		if(x < 3)
+		{
+			header = new QLabel(tr(channelNames[x]), this);
+		}
+		else if(count == 0)
+		{
+			header = new QLabel(x == 3? tr("sRed") : tr("sGreen"), this);
+		}
+		else
+		{
+			QComboBox * box = new QComboBox(this);
+
+			for(int m = 0; m < modifiers; ++m)
+			{
+				for(int c = 0; c < 4; ++c)
+					box->addItem(tr("%1 %2").arg(tr(channelNames[c])).arg(m + 1), m*4 + c);
+			}
+
+			box->setCurrentIndex(box->findData(window->modifierChannel[x - 3]));
+			connect(box, SIGNAL(currentIndexChanged(int)), this, SLOT(updateMatrixDisplay(int)));
+			sourceBox.push_back(box);
+			header = box;
+		}
+
+		ui->matrixLayout->addWidget(header, 0, 1 + x);
+		cells.push_back(header);
+	}
+
+	for(int y = 0; y < MATRIX_ROWS; ++y)
+	{
+		QLabel * label = new QLabel(tr(channelNames[y]), this);
+		ui->matrixLayout->addWidget(label, 1 + y, 0);
+		cells.push_back(label);
+
+		for(int x = 0; x < cols; ++x)
+		{
+			QSpinBox * box = new QSpinBox(this);
+			box->setMaximum(255);
+			box->setValue(weights[y*stride + x]);
+			connect(box, SIGNAL(valueChanged(int)), this, SLOT(updateMatrixDisplay(int)));
+
+			ui->matrixLayout->addWidget(box, 1 + y, 1 + x);
+			spinBox.push_back(box);
+			cells.push_back(box);
+		}
+	}
+
+	adjustSize();
+}
+
+void MatrixEditor::setColumns(int count)
+{
+	TransformParams params = window->params(RenderMatrix);
+	ImageTransform::setModifierCount(params, count);
+	SessionRecorder::recordEdit(params);
+	window->adoptParams(params);
+	rebuild();
+}
+
 void MatrixEditor::updateMatrixDisplay(int)
 {
-	for(size_t i = 0; i < spinBox.size(); ++i)
+	const int count  = window->modifierCount;
+	const int cols   = count? 3 + count : MATRIX_COLS;
+	const int stride = count? WIDE_COLS : MATRIX_COLS;
+	uint8_t * weights = count? window->wide : window->matrix;
+
+	for(int i = 0; i < spinBox.size(); ++i)
+	{
+		weights[i / cols * stride + i % cols] = spinBox[i]->value();
+	}
+
+	for(int i = 0; i < sourceBox.size(); ++i)
 	{
-		window->matrix[i] = spinBox[i]->value();
+		window->modifierChannel[i] = sourceBox[i]->currentData().toInt();
 	}
 
+	SessionRecorder::recordEdit(window->params(RenderMatrix));
 	window->applyMatrix();
 	window->ui->widget->repaint();
 }
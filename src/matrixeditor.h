@@ -1,14 +1,15 @@
 #ifndef MATRIXEDITOR_H
 #define MATRIXEDITOR_H
 #include "mainwindow.h"
-#include <array>
 #include <QDialog>
+#include <QVector>
 
 namespace Ui {
 class MatrixEditor;
 }
 
 class QSpinBox;
+class QComboBox;
 class MainWindow;
 
 class MatrixEditor : public QDialog
@@ -23,12 +24,19 @@ public slots:
 	void accepted();
 	void rejected();
 	void updateMatrixDisplay(int);
+	void setColumns(int count);
 
 private:
-	uint8_t originalMatrix[MATRIX_SIZE];
+	void rebuild();
+
+	TransformParams originalParams;
 
 	MainWindow * window;
-	std::array<QSpinBox*, MATRIX_SIZE> spinBox;
+
+//one spin box per weight, row by row, and a source above each modifier column of the wide matrix
+	QVector<QWidget*>   cells;
+	QVector<QSpinBox*>  spinBox;
+	QVector<QComboBox*> sourceBox;
 	Ui::MatrixEditor *ui;
 };
 
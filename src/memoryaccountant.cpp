@@ -0,0 +1,168 @@
+#include "memoryaccountant.h"
+#include <QMutex>
+#include <QStringList>
+#include <QVector>
+#include <algorithm>
+
+namespace MemoryAccountant
+{
+
+struct Registered
+{
+	const void * owner;
+	int          priority;
+	Evictor      evict;
+};
+
+static QMutex              mutex;
+static qint64              usage[CategoryCount];
+static qint64              sum   = 0;
+static qint64              high  = 0;
+static qint64              limit = 0;
+static QVector<Registered> evictors;
+
+static void add(Category category, qint64 bytes)
+{
+	QMutexLocker lock(&mutex);
+	usage[category] += bytes;
+	sum  += bytes;
+	high  = std::max(high, sum);
+}
+
+Account::Account(Category category, qint64 bytes) :
+	category(category),
+	current(0)
+{
+	set(bytes);
+}
+
+Account::~Account()
+{
+	set(0);
+}
+
+void Account::set(qint64 bytes)
+{
+	if(bytes != current)
+	{
+		add(category, bytes - current);
+		current = bytes;
+	}
+}
+
+void addEvictor(const void * owner, int priority, const Evictor & evict)
+{
+	QMutexLocker lock(&mutex);
+	evictors.push_back(Registered{owner, priority, evict});
+
+	std::stable_sort(evictors.begin(), evictors.end(), [](const Registered & a, const Registered & b)
+	{
+		return a.priority < b.priority;
+	});
+}
+
+void removeEvictors(const void * owner)
+{
+	QMutexLocker lock(&mutex);
+	evictors.erase(std::remove_if(evictors.begin(), evictors.end(), [owner](const Registered & it) { return it.owner == owner; }), evictors.end());
+}
+
+void setBudget(qint64 bytes)
+{
+	QMutexLocker lock(&mutex);
+	limit = std::max<qint64>(0, bytes);
+}
+
+qint64 budget()
+{
+	QMutexLocker lock(&mutex);
+	return limit;
+}
+
+//adds to the account only if the total stays within the budget, otherwise returns how far over it would go
+static qint64 take(Category category, qint64 & current, qint64 bytes)
+{
+	QMutexLocker lock(&mutex);
+
+	const qint64 excess = limit? sum + bytes - limit : 0;
+
+	if(excess <= 0)
+	{
+		usage[category] += bytes;
+		sum  += bytes;
+		high  = std::max(high, sum);
+		current += bytes;
+	}
+
+	return excess;
+}
+
+//the evictors run unlocked, they set their own accounts
+bool reserve(Account & account, qint64 bytes)
+{
+	qint64 excess = take(account.category, account.current, bytes);
+
+	if(excess <= 0)
+	{
+		return true;
+	}
+
+	QVector<Registered> order;
+
+	{
+		QMutexLocker lock(&mutex);
+		order = evictors;
+	}
+
+	for(const Registered & it : order)
+	{
+		it.evict(excess);
+		excess = take(account.category, account.current, bytes);
+
+		if(excess <= 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+qint64 used(Category category)
+{
+	QMutexLocker lock(&mutex);
+	return usage[category];
+}
+
+qint64 total()
+{
+	QMutexLocker lock(&mutex);
+	return sum;
+}
+
+qint64 peak()
+{
+	QMutexLocker lock(&mutex);
+	return high;
+}
+
+QString report()
+{
+	static const char * const names[CategoryCount] = { "Sources", "Renders", "Render cache", "Tiles", "Scratch" };
+	QStringList lines;
+
+	QMutexLocker lock(&mutex);
+
+	for(int c = 0; c < CategoryCount; ++c)
+	{
+		lines << QString("%1: %2 MiB").arg(names[c]).arg(usage[c] / 1048576.0, 0, 'f', 1);
+	}
+
+	lines << (limit? QString("Total: %1 of %2 MiB").arg(sum / 1048576.0, 0, 'f', 1).arg(limit / 1048576.0, 0, 'f', 1)
+				   : QString("Total: %1 MiB, no budget").arg(sum / 1048576.0, 0, 'f', 1));
+	lines << QString("Peak: %1 MiB").arg(high / 1048576.0, 0, 'f', 1);
+
+	return lines.join('\n');
+}
+
+}
@@ -0,0 +1,65 @@
+#ifndef MEMORYACCOUNTANT_H
+#define MEMORYACCOUNTANT_H
+#include <QString>
+#include <functional>
+
+//process wide count of the large buffers, by category, with an optional budget that caches are evicted to meet
+namespace MemoryAccountant
+{
+//sources are decoded images and modifiers, renders the full size results in use, scratch the swap stages and tables
+	enum Category
+	{
+		CategorySources,
+		CategoryRenders,
+		CategoryRenderCache,
+		CategoryTiles,
+		CategoryScratch,
+		CategoryCount
+	};
+
+//bytes held by one owner in a category, counted until the account is destroyed; accounts may live on any thread
+	class Account
+	{
+	public:
+		explicit Account(Category category, qint64 bytes = 0);
+		~Account();
+
+		void   set(qint64 bytes);
+		qint64 bytes() const { return current; }
+
+	private:
+		Account(const Account &);
+		Account & operator=(const Account &);
+
+		friend bool reserve(Account & account, qint64 bytes);
+
+		Category category;
+		qint64   current;
+	};
+
+//a cache that can give memory back; asked to free about bytes, it updates its account and returns what it freed
+	typedef std::function<qint64 (qint64 bytes)> Evictor;
+
+//evictors are asked in increasing priority order, the cheapest to rebuild first
+	void addEvictor(const void * owner, int priority, const Evictor & evict);
+	void removeEvictors(const void * owner);
+
+//in bytes, 0 for no budget
+	void   setBudget(qint64 bytes);
+	qint64 budget();
+
+//takes bytes more for account if they fit in the budget once caches have been evicted as needed; the check and the
+//taking happen under one lock, so concurrent reservations cannot overshoot together. On false the account is unchanged
+//and the work should be refused, otherwise the owner sets the account to what it really holds once it has allocated.
+//The evictors run on the calling thread
+	bool reserve(Account & account, qint64 bytes);
+
+	qint64 used(Category category);
+	qint64 total();
+	qint64 peak();
+
+//one line per category, then the total against the budget and the peak of the session
+	QString report();
+}
+
+#endif // MEMORYACCOUNTANT_H
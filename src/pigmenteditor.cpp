@@ -25,6 +25,8 @@ ui(new Ui::PigmentEditor)
 	{
 		sliders[i]->setValue(window->pigments[i]);
 		connect(sliders[i], &QSlider::valueChanged, this, &PigmentEditor::updateDisplay);
+		connect(sliders[i], &QSlider::sliderPressed, this, [window]() { window->setDragging(true); });
+		connect(sliders[i], &QSlider::sliderReleased, this, [window]() { window->setDragging(false); });
 	}
 
 	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &PigmentEditor::accepted);
@@ -58,6 +60,7 @@ void PigmentEditor::updateDisplay(int)
 		window->pigments[i] = sliders[i]->value();
 	}
 
+	SessionRecorder::recordEdit(window->params(RenderPigments));
 	window->applyPigments();
 	window->ui->widget->repaint();
 }
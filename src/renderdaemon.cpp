@@ -0,0 +1,279 @@
+#include "renderdaemon.h"
+#include "imagetransform.h"
+#include "imagesequence.h"
+#include "scheduler.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QImageReader>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+#include <QSharedMemory>
+#include <QTextStream>
+#include <QThreadPool>
+#include <cstring>
+#include <limits>
+
+static const int imageCacheBudget = 512*1024;
+
+RenderDaemon::RenderDaemon(QObject *parent) : QObject(parent),
+	server(new QLocalServer(this)),
+	imageMemory(MemoryAccountant::CategorySources)
+{
+	imageCache.setMaxCost(imageCacheBudget);
+	connect(server, &QLocalServer::newConnection, this, &RenderDaemon::connection);
+
+//jobs reserve on the pool, so the cache gives memory back under its lock
+	MemoryAccountant::addEvictor(this, 0, [this](qint64 bytes)
+	{
+		QMutexLocker lock(&cacheLock);
+		const qint64 before = imageMemory.bytes();
+		imageCache.setMaxCost((int) std::max<qint64>(0, imageCache.totalCost() - (bytes + 1023) / 1024));
+		imageCache.setMaxCost(imageCacheBudget);
+		imageMemory.set((qint64) imageCache.totalCost() * 1024);
+		return before - imageMemory.bytes();
+	});
+}
+
+RenderDaemon::~RenderDaemon()
+{
+	QThreadPool::globalInstance()->waitForDone();
+	MemoryAccountant::removeEvictors(this);
+}
+
+bool RenderDaemon::listen(const QString & name)
+{
+	QLocalServer::removeServer(name);
+	return server->listen(name);
+}
+
+void RenderDaemon::connection()
+{
+	while(QLocalSocket * socket = server->nextPendingConnection())
+	{
+		connect(socket, &QLocalSocket::readyRead, this, [this, socket]() { readJobs(socket); });
+		connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+	}
+}
+
+void RenderDaemon::readJobs(QLocalSocket * socket)
+{
+	while(socket->canReadLine())
+	{
+		QJsonParseError error;
+		QJsonDocument document = QJsonDocument::fromJson(socket->readLine(), &error);
+
+		if(!document.isObject())
+		{
+			QJsonObject reply;
+			reply.insert("ok", false);
+			reply.insert("error", error.errorString());
+			socket->write(QJsonDocument(reply).toJson(QJsonDocument::Compact) + '\n');
+			continue;
+		}
+
+//jobs run on the warm global pool as bulk work, replies go out in completion order tagged with the job id
+		QPointer<QLocalSocket> target(socket);
+		QFutureWatcher<QJsonObject> * watcher = new QFutureWatcher<QJsonObject>(this);
+
+		connect(watcher, &QFutureWatcher<QJsonObject>::finished, this, [watcher, target]()
+		{
+			if(target)
+			{
+				target->write(QJsonDocument(watcher->result()).toJson(QJsonDocument::Compact) + '\n');
+			}
+
+			watcher->deleteLater();
+		});
+
+		QJsonObject job = document.object();
+		watcher->setFuture(Scheduler::run<QJsonObject>(Scheduler::PriorityBulk, [this, job]() { return process(job); }));
+	}
+}
+
+static QString cacheKey(const QString & path)
+{
+	QFileInfo info(path);
+	return info.absoluteFilePath() + '@' + QString::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+//what decoding path will take beyond the cache, 0 if it is cached or its size is unknown
+qint64 RenderDaemon::decodeBytes(const QString & path)
+{
+	{
+		QMutexLocker lock(&cacheLock);
+		if(imageCache.contains(cacheKey(path)))
+		{
+			return 0;
+		}
+	}
+
+	return ImageSequence::decodedBytes(path, 1);
+}
+
+QImage RenderDaemon::decode(const QString & path, QString & error)
+{
+	const QString key = cacheKey(path);
+
+	{
+		QMutexLocker lock(&cacheLock);
+		if(QImage * cached = imageCache.object(key))
+		{
+			return *cached;
+		}
+	}
+
+	QImageReader reader(path);
+	reader.setAutoTransform(true);
+	QImage image = reader.read();
+
+	if(image.isNull())
+	{
+		error = QString("Cannot load %1: %2").arg(path, reader.errorString());
+		return image;
+	}
+
+	image = image.convertToFormat(ImageSequence::workingFormat(image));
+
+	QMutexLocker lock(&cacheLock);
+	imageCache.insert(key, new QImage(image), std::max(1, image.byteCount() / 1024));
+	imageMemory.set((qint64) imageCache.totalCost() * 1024);
+	return image;
+}
+
+QJsonObject RenderDaemon::process(const QJsonObject & job)
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	QJsonObject reply;
+	reply.insert("id", job.value("id"));
+
+	TransformParams params = ImageTransform::paramsFromJson(job);
+	QString error;
+
+	QImage original, modifier;
+	QSharedMemory shared;
+
+//the size comes from the client, rows are packed in the segment
+	const bool   inPlace = job.contains("shm");
+	const int    width   = job.value("width").toInt();
+	const int    height  = job.value("height").toInt();
+	const bool   sized   = width > 0 && height > 0 && width <= std::numeric_limits<int>::max() / 4;
+	const qint64 stride  = (qint64) width * 4;
+
+//the render and any input the cache does not hold yet; decoded inputs move to the cache's account
+	MemoryAccountant::Account memory(MemoryAccountant::CategoryRenders);
+	const qint64 renderBytes = inPlace
+		? (sized? stride * height : 0)
+		: ImageSequence::decodedBytes(job.value("input").toString(), 1);
+	const qint64 inputBytes  = inPlace? 0
+		: decodeBytes(job.value("input").toString()) + (job.contains("modifier")? decodeBytes(job.value("modifier").toString()) : 0);
+
+	if(inPlace && !sized)
+	{
+		error = QString("Invalid size %1x%2").arg(width).arg(height);
+	}
+	else if(!MemoryAccountant::reserve(memory, renderBytes + inputBytes))
+	{
+		error = "Job does not fit the memory budget";
+	}
+	else if(inPlace)
+	{
+		shared.setKey(job.value("shm").toString());
+
+		if(!shared.attach())
+		{
+			error = QString("Cannot attach shared memory %1").arg(shared.key());
+		}
+		else if(shared.size() < stride * height)
+		{
+			error = QString("Shared memory %1 is smaller than %2x%3 pixels").arg(shared.key()).arg(width).arg(height);
+			shared.detach();
+		}
+		else
+		{
+			shared.lock();
+			original = QImage((const uchar *) shared.constData(), width, height, (int) stride, QImage::Format_ARGB32);
+		}
+	}
+	else
+	{
+		original = decode(job.value("input").toString(), error);
+	}
+
+	if(error.isEmpty() && job.contains("modifier"))
+	{
+		modifier = decode(job.value("modifier").toString(), error);
+//the transforms expect a modifier in its base's format, as the window converts them
+		if(!modifier.isNull() && modifier.format() != original.format())
+			modifier = modifier.convertToFormat(original.format());
+	}
+
+	const double decoded = timer.nsecsElapsed() / 1e6;
+	memory.set(std::min(memory.bytes(), renderBytes));
+	double rendered = decoded;
+
+	if(error.isEmpty())
+	{
+		QImage render = ImageTransform::render(original, modifier, params);
+		rendered = timer.nsecsElapsed() / 1e6;
+
+		if(shared.isAttached() && render.constBits() != shared.constData())
+		{
+			for(int y = 0; y < render.height(); ++y)
+			{
+				memcpy((uchar *) shared.data() + y * stride, render.constScanLine(y), (size_t) stride);
+			}
+		}
+
+		if(job.contains("output") && !render.save(job.value("output").toString()))
+		{
+			error = QString("Cannot write %1").arg(job.value("output").toString());
+		}
+	}
+
+	if(shared.isAttached())
+	{
+		shared.unlock();
+		shared.detach();
+	}
+
+	const double finished = timer.nsecsElapsed() / 1e6;
+
+	reply.insert("ok", error.isEmpty());
+	if(!error.isEmpty()) reply.insert("error", error);
+	reply.insert("ms", finished);
+	reply.insert("decodeMs", decoded);
+	reply.insert("renderMs", rendered - decoded);
+	reply.insert("encodeMs", finished - rendered);
+	return reply;
+}
+
+int RenderDaemon::run(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("daemon"));
+	parser.addOption(QCommandLineOption("name", "Local socket name to listen on.", "name", "ColorTester"));
+	parser.addOption(QCommandLineOption("memory-budget", "Evict decoded inputs, then refuse jobs, past <MiB> of image buffers.", "MiB"));
+	parser.process(arguments);
+
+	MemoryAccountant::setBudget(parser.value("memory-budget").toLongLong() * 1048576);
+
+	RenderDaemon daemon;
+
+	if(!daemon.listen(parser.value("name")))
+	{
+		QTextStream(stderr) << "Cannot listen on " << parser.value("name") << endl;
+		return 1;
+	}
+
+	QTextStream(stderr) << "Listening on " << daemon.server->fullServerName() << endl;
+	return QCoreApplication::exec();
+}
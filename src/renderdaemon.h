@@ -0,0 +1,47 @@
+#ifndef RENDERDAEMON_H
+#define RENDERDAEMON_H
+#include "memoryaccountant.h"
+#include <QObject>
+#include <QCache>
+#include <QImage>
+#include <QMutex>
+#include <QJsonObject>
+#include <QStringList>
+
+class QLocalServer;
+class QLocalSocket;
+
+//serves render jobs over a local socket, one JSON object per line each way
+//ColorTester --daemon [--name socket] [--memory-budget MiB]
+//job:   {"id": 1, "input": "a.png", "modifier": "m.png", "output": "b.png", "transform": "pigments", "pigments": [...]}
+//       or {"shm": key, "width": w, "height": h, ...} to transform ARGB32 pixels in a QSharedMemory segment in place
+//reply: {"id": 1, "ok": true, "ms": 4.2, "decodeMs": 1.1, "renderMs": 2.0, "encodeMs": 1.1}
+class RenderDaemon : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit RenderDaemon(QObject *parent = 0);
+	~RenderDaemon();
+
+	bool listen(const QString & name);
+
+	static int run(const QStringList & arguments);
+
+private:
+	void connection();
+	void readJobs(QLocalSocket * socket);
+
+	QJsonObject process(const QJsonObject & job);
+	QImage      decode(const QString & path, QString & error);
+	qint64      decodeBytes(const QString & path);
+
+	QLocalServer * server;
+
+//decoded inputs stay warm between jobs, keyed by path and modification time; cost is in KiB
+	QMutex                 cacheLock;
+	QCache<QString, QImage> imageCache;
+	MemoryAccountant::Account imageMemory;
+};
+
+#endif // RENDERDAEMON_H
@@ -21,6 +21,8 @@ ui(new Ui::RotationEditor)
 	{
 		sliders[i]->setValue(window->angles[i]);
 		connect(sliders[i], &QSlider::valueChanged, this, &RotationEditor::updateAngleDisplay);
+		connect(sliders[i], &QSlider::sliderPressed, this, [window]() { window->setDragging(true); });
+		connect(sliders[i], &QSlider::sliderReleased, this, [window]() { window->setDragging(false); });
 	}
 
 	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &RotationEditor::accepted);
@@ -54,6 +56,7 @@ void RotationEditor::updateAngleDisplay(int)
 		window->angles[i] = sliders[i]->value();
 	}
 
+	SessionRecorder::recordEdit(window->params(RenderAngles));
 	window->applyAngles();
 	window->ui->widget->repaint();
 }
@@ -0,0 +1,245 @@
+#include "scheduler.h"
+#include <QThreadPool>
+#include <QRunnable>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace Scheduler
+{
+
+//QThreadPool starts higher numbers first; QtConcurrent's own tasks use 0, alongside bulk work
+static const int poolPriority[PriorityCount] = { 2, 1, 0 };
+
+static thread_local Priority threadPriority = PriorityRefine;
+static thread_local bool     inTask = false;
+
+struct Counters
+{
+	std::atomic<int> queued;
+	std::atomic<int> running;
+	QMutex           mutex;
+	qint64           started;
+	qint64           totalWait;
+	qint64           maxWait;
+};
+
+static Counters counters[PriorityCount];
+
+static qint64 now()
+{
+	static const QElapsedTimer clock = []() { QElapsedTimer it; it.start(); return it; }();
+	return clock.nsecsElapsed();
+}
+
+//true while work of a higher class waits for a thread
+static bool higherWaiting(Priority priority)
+{
+	for(int c = 0; c < priority; ++c)
+	{
+		if(counters[c].queued > 0)
+			return true;
+	}
+
+	return false;
+}
+
+class Task : public QRunnable
+{
+public:
+	Task(Priority priority, const std::function<void ()> & fn) :
+		priority(priority),
+		fn(fn),
+		queuedAt(now())
+	{
+	}
+
+	void run() Q_DECL_OVERRIDE
+	{
+		Counters & it = counters[priority];
+		const qint64 wait = now() - queuedAt;
+
+		--it.queued;
+		++it.running;
+
+		{
+			QMutexLocker lock(&it.mutex);
+			++it.started;
+			it.totalWait += wait;
+			it.maxWait = std::max(it.maxWait, wait);
+		}
+
+		const Priority outer = threadPriority;
+		threadPriority = priority;
+		inTask = true;
+
+		fn();
+
+		threadPriority = outer;
+		inTask = false;
+		--it.running;
+	}
+
+private:
+	Priority              priority;
+	std::function<void ()> fn;
+	qint64                queuedAt;
+};
+
+Priority current()
+{
+	return threadPriority;
+}
+
+Scope::Scope(Priority priority) :
+	previous(threadPriority)
+{
+	threadPriority = priority;
+}
+
+Scope::~Scope()
+{
+	threadPriority = previous;
+}
+
+void start(Priority priority, const std::function<void ()> & fn)
+{
+	++counters[priority].queued;
+	QThreadPool::globalInstance()->start(new Task(priority, fn), poolPriority[priority]);
+}
+
+//bands are claimed one at a time, so whoever runs them can stop between any two
+struct Job
+{
+	const std::function<void (int)> * fn;
+	Priority         priority;
+	int              count;
+	std::atomic<int> next;
+	int              done;
+	QMutex           mutex;
+	QWaitCondition   finished;
+};
+
+static void finish(Job & job)
+{
+	QMutexLocker lock(&job.mutex);
+
+	if(++job.done == job.count)
+	{
+		job.finished.wakeAll();
+	}
+}
+
+//runs bands until none are left, or queues itself again behind higher work that is waiting for a thread;
+//fn is only called while map() is still waiting, helpers that start later find no bands and leave
+static void work(const std::shared_ptr<Job> & job)
+{
+	for(;;)
+	{
+		if(higherWaiting(job->priority))
+		{
+			start(job->priority, [job]() { work(job); });
+			return;
+		}
+
+		const int index = job->next++;
+
+		if(index >= job->count)
+		{
+			return;
+		}
+
+		(*job->fn)(index);
+		finish(*job);
+	}
+}
+
+void map(Priority priority, int count, const std::function<void (int index)> & fn)
+{
+	Scope scope(priority);
+
+	if(count <= 1)
+	{
+		if(count == 1) fn(0);
+		return;
+	}
+
+	std::shared_ptr<Job> job = std::make_shared<Job>();
+	job->fn       = &fn;
+	job->priority = priority;
+	job->count    = count;
+	job->next     = 0;
+	job->done     = 0;
+
+	const int helpers = std::min(count, QThread::idealThreadCount()) - 1;
+
+	for(int i = 0; i < helpers; ++i)
+	{
+		start(priority, [job]() { work(job); });
+	}
+
+//the caller takes bands too, so waiting from inside a pool thread never starves the pool;
+//a caller that is itself a task stands back for higher work and lends its thread to the pool meanwhile
+	for(;;)
+	{
+		if(!(inTask && higherWaiting(priority)))
+		{
+			const int index = job->next++;
+
+			if(index < count)
+			{
+				fn(index);
+				finish(*job);
+				continue;
+			}
+		}
+
+		QMutexLocker lock(&job->mutex);
+
+		if(job->done == count)
+		{
+			break;
+		}
+
+		if(inTask) QThreadPool::globalInstance()->releaseThread();
+		job->finished.wait(&job->mutex, 2);
+		if(inTask) QThreadPool::globalInstance()->reserveThread();
+	}
+}
+
+ClassStats stats(Priority priority)
+{
+	Counters & it = counters[priority];
+	QMutexLocker lock(&it.mutex);
+
+	ClassStats stats;
+	stats.queued   = it.queued;
+	stats.running  = it.running;
+	stats.started  = it.started;
+	stats.meanWait = it.started? it.totalWait / 1e6 / it.started : 0.0;
+	stats.maxWait  = it.maxWait / 1e6;
+	return stats;
+}
+
+QString report()
+{
+	static const char * const names[PriorityCount] = { "Interactive", "Refine", "Bulk" };
+	QStringList lines;
+
+	for(int c = 0; c < PriorityCount; ++c)
+	{
+		const ClassStats it = stats((Priority) c);
+		lines << QString("%1: %2 queued, %3 running, %4 tasks, wait %5 ms mean, %6 ms max")
+				 .arg(names[c]).arg(it.queued).arg(it.running).arg(it.started)
+				 .arg(it.meanWait, 0, 'f', 2).arg(it.maxWait, 0, 'f', 2);
+	}
+
+	return lines.join('\n');
+}
+
+}
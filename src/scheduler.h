@@ -0,0 +1,74 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <QFuture>
+#include <QFutureInterface>
+#include <QString>
+#include <functional>
+
+//priority classes for work on the global thread pool: queued work of a higher class starts first, and band loops
+//of a lower class hand their threads back between bands while higher work is waiting for one
+namespace Scheduler
+{
+//interactive is the viewport and renders while a slider is dragged, refine the full size render once it is let go,
+//bulk is saves, exports, thumbnails and statistics
+	enum Priority
+	{
+		PriorityInteractive,
+		PriorityRefine,
+		PriorityBulk,
+		PriorityCount
+	};
+
+//waits are in ms from being queued to getting a thread, over every task of the class so far
+	struct ClassStats
+	{
+		int    queued;
+		int    running;
+		qint64 started;
+		double meanWait;
+		double maxWait;
+	};
+
+//the class of the work running on this thread; PriorityRefine outside of any scope or task
+	Priority current();
+
+//work started on this thread while a scope lives, including the bands of ImageTransform passes, runs in its class
+	class Scope
+	{
+	public:
+		explicit Scope(Priority priority);
+		~Scope();
+
+	private:
+		Priority previous;
+	};
+
+//fn(0) to fn(count-1), one band at a time on the pool and the calling thread; returns when all are done
+	void map(Priority priority, int count, const std::function<void (int index)> & fn);
+
+//fn on the pool without waiting
+	void start(Priority priority, const std::function<void ()> & fn);
+
+	template<typename T>
+	QFuture<T> run(Priority priority, const std::function<T ()> & fn)
+	{
+		QFutureInterface<T> * promise = new QFutureInterface<T>();
+		promise->reportStarted();
+		QFuture<T> future = promise->future();
+
+		start(priority, [promise, fn]()
+		{
+			promise->reportResult(fn());
+			promise->reportFinished();
+			delete promise;
+		});
+
+		return future;
+	}
+
+	ClassStats stats(Priority priority);
+//one line per class, for the status bar
+	QString    report();
+}
+
+#endif // SCHEDULER_H
@@ -0,0 +1,365 @@
+#include "sessionrecorder.h"
+#include "mainwindow.h"
+#include "imagetransform.h"
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImageReader>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThread>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace SessionRecorder
+{
+
+//a frame at 60 Hz; inputs presented later than this missed the next refresh
+static const double frameBudget = 1000.0 / 60;
+
+static QFile * output = nullptr;
+static qint64  origin = 0;
+
+//everything below runs on the UI thread
+static QVector<qint64>     pending;
+static std::vector<double> latencies;
+static int                 frames  = 0;
+static int                 dropped = 0;
+//edits replay skipped because a newer one fell due with them, and inputs no frame presented before the report
+static int                 compressed  = 0;
+static int                 unpresented = 0;
+
+static qint64 now()
+{
+	static const QElapsedTimer clock = []() { QElapsedTimer it; it.start(); return it; }();
+	return clock.nsecsElapsed();
+}
+
+bool startRecording(const QString & fileName, QString * error)
+{
+	stopRecording();
+
+	output = new QFile(fileName);
+
+	if(!output->open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+	{
+		if(error) *error = output->errorString();
+		delete output;
+		output = nullptr;
+		return false;
+	}
+
+	origin = now();
+	return true;
+}
+
+//nearest rank, sorted ascending
+static double percentile(const std::vector<double> & sorted, double p)
+{
+	if(sorted.empty())
+	{
+		return 0;
+	}
+
+	const size_t rank = (size_t) std::ceil(p / 100 * sorted.size());
+	return sorted[std::max<size_t>(rank, 1) - 1];
+}
+
+static void report(FILE * file)
+{
+	std::vector<double> sorted = latencies;
+	std::sort(sorted.begin(), sorted.end());
+
+	const int late = std::count_if(sorted.begin(), sorted.end(), [](double it) { return it > frameBudget; });
+
+	fprintf(file, "%d inputs, %d frames, %d dropped, %d over %.1f ms\n", (int) sorted.size(), frames, dropped, late, frameBudget);
+	if(compressed || unpresented)
+		fprintf(file, "%d edits compressed on replay, %d inputs never presented\n", compressed, unpresented);
+	fprintf(file, "input to frame p50 %.2f ms  p95 %.2f ms  p99 %.2f ms  max %.2f ms\n",
+		percentile(sorted, 50), percentile(sorted, 95), percentile(sorted, 99), sorted.empty()? 0.0 : sorted.back());
+	fflush(file);
+}
+
+static void reset()
+{
+	pending.clear();
+	latencies.clear();
+	frames  = 0;
+	dropped = 0;
+	compressed  = 0;
+	unpresented = 0;
+}
+
+void stopRecording()
+{
+	if(!output)
+	{
+		return;
+	}
+
+	output->close();
+	delete output;
+	output = nullptr;
+
+	unpresented += pending.size();
+	report(stderr);
+	reset();
+}
+
+//drags only change the quality tier of the inputs that follow, they wait for no frame of their own
+static void write(const char * key, const QJsonValue & value, bool measured = true)
+{
+	if(!output)
+	{
+		return;
+	}
+
+	const qint64 at = now();
+	if(measured) pending.push_back(at);
+
+	QJsonObject object;
+	object.insert("t", (at - origin) / 1e6);
+	object.insert(key, value);
+	output->write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void recordEdit(const TransformParams & params)
+{
+	write("edit", ImageTransform::paramsToJson(params));
+}
+
+void recordDrag(bool dragging)
+{
+	write("drag", dragging, false);
+}
+
+void recordZoom(double zoom)
+{
+	write("zoom", zoom);
+}
+
+void recordScroll(const QPoint & position)
+{
+	write("scroll", QJsonArray() << position.x() << position.y());
+}
+
+void recordResize(const QSize & size)
+{
+	write("resize", QJsonArray() << size.width() << size.height());
+}
+
+void presented()
+{
+	if(pending.isEmpty())
+	{
+		return;
+	}
+
+	const qint64 at = now();
+
+	for(qint64 input : pending)
+	{
+		latencies.push_back((at - input) / 1e6);
+	}
+
+	dropped += pending.size() - 1;
+	++frames;
+	pending.clear();
+}
+
+QVector<Event> read(const QString & fileName, QString * error)
+{
+	QFile file(fileName);
+
+	if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	{
+		if(error) *error = file.errorString();
+		return QVector<Event>();
+	}
+
+	QVector<Event> events;
+
+	for(int line = 1; !file.atEnd(); ++line)
+	{
+		const QByteArray text = file.readLine().trimmed();
+
+		if(text.isEmpty())
+		{
+			continue;
+		}
+
+		const QJsonObject object = QJsonDocument::fromJson(text).object();
+
+		Event event;
+		event.time     = object.value("t").toDouble(-1);
+		event.params   = ImageTransform::defaultParams();
+		event.dragging = false;
+		event.zoom     = 1.0;
+
+		if(object.contains("edit"))
+		{
+			event.type   = EventEdit;
+			event.params = ImageTransform::paramsFromJson(object.value("edit").toObject());
+		}
+		else if(object.contains("drag"))
+		{
+			event.type     = EventDrag;
+			event.dragging = object.value("drag").toBool();
+		}
+		else if(object.contains("zoom"))
+		{
+			event.type = EventZoom;
+			event.zoom = object.value("zoom").toDouble(1.0);
+		}
+		else if(object.contains("scroll"))
+		{
+			const QJsonArray position = object.value("scroll").toArray();
+			event.type     = EventScroll;
+			event.position = QPoint(position.at(0).toInt(), position.at(1).toInt());
+		}
+		else if(object.contains("resize"))
+		{
+			const QJsonArray size = object.value("resize").toArray();
+			event.type = EventResize;
+			event.size = QSize(size.at(0).toInt(), size.at(1).toInt());
+		}
+		else
+		{
+			event.time = -1;
+		}
+
+		if(event.time < 0)
+		{
+			if(error) *error = QString("%1:%2: not a recorded event").arg(fileName).arg(line);
+			return QVector<Event>();
+		}
+
+		events.push_back(event);
+	}
+
+	if(events.isEmpty() && error)
+	{
+		*error = QString("%1: no events").arg(fileName);
+	}
+
+	return events;
+}
+
+//inputs are applied at their recorded times; those that fall due while a frame is still being made are applied together
+//and only the newest edit among them renders, like a window system compressing the mouse moves queued behind a slow frame
+static void play(MainWindow & window, const QVector<Event> & events)
+{
+	const qint64 start = now();
+	auto due = [start, &events](int i) { return start + (qint64) (events[i].time * 1e6); };
+
+	int next = 0;
+
+	while(next < events.size())
+	{
+		QApplication::processEvents();
+
+		const qint64 at = now();
+
+		if(at < due(next))
+		{
+			QThread::usleep((unsigned long) std::min<qint64>(1000, (due(next) - at) / 1000));
+			continue;
+		}
+
+		int end = next;
+		while(end < events.size() && due(end) <= at)
+		{
+			++end;
+		}
+
+		for(int i = next; i < end; ++i)
+		{
+			bool superseded = false;
+			for(int j = i + 1; j < end && events[i].type == EventEdit; ++j)
+			{
+				superseded |= events[j].type == EventEdit;
+			}
+
+//only inputs that are applied wait for a frame, the compressed ones are counted apart
+			if(superseded)
+			{
+				++compressed;
+				continue;
+			}
+
+			if(events[i].type != EventDrag) pending.push_back(due(i));
+			window.replay(events[i]);
+		}
+
+		next = end;
+	}
+
+//scrolling paints on the next pass of the event loop
+	const qint64 settle = now() + 1000000000;
+
+	while(!pending.isEmpty() && now() < settle)
+	{
+		QApplication::processEvents();
+		QThread::usleep(1000);
+	}
+
+	unpresented += pending.size();
+	pending.clear();
+}
+
+int replay(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("replay", "Session recorded with --record.", "session"));
+	parser.addOption(QCommandLineOption("repeat", "Times to play the session, the latencies of every run are pooled.", "n", "1"));
+	parser.addPositionalArgument("image", "Base image to play the session on.");
+	parser.process(arguments);
+
+	QString error;
+	const QVector<Event> events = read(parser.value("replay"), &error);
+	const QStringList    files  = parser.positionalArguments();
+
+	if(files.isEmpty())
+	{
+		fprintf(stderr, "usage: ColorTester --replay <session> <image> [--repeat n]\n");
+		return 2;
+	}
+
+	if(events.isEmpty())
+	{
+		fprintf(stderr, "%s\n", qPrintable(error));
+		return 2;
+	}
+
+//openImage() would stop on a message box, which nobody can answer headless
+	if(!QImageReader(files.first()).canRead())
+	{
+		fprintf(stderr, "Cannot read %s\n", qPrintable(files.first()));
+		return 2;
+	}
+
+	MainWindow window;
+	window.show();
+
+	if(!window.openImage(files.first()))
+	{
+		return 2;
+	}
+
+	QApplication::processEvents();
+
+	for(int run = std::max(1, parser.value("repeat").toInt()); run > 0; --run)
+	{
+		play(window, events);
+	}
+
+	report(stdout);
+	return 0;
+}
+
+}
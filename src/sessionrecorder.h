@@ -0,0 +1,54 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+#include "colortransform.h"
+#include <QPoint>
+#include <QSize>
+#include <QStringList>
+#include <QVector>
+
+//editing sessions as timed input events, and the latency from each input to the frame that presents it;
+//ColorTester --record <file> [image] records one, ColorTester --replay <file> <image> plays it back headless and reports
+namespace SessionRecorder
+{
+	enum EventType
+	{
+		EventEdit,
+		EventDrag,
+		EventZoom,
+		EventScroll,
+		EventResize
+	};
+
+//one JSON object per line: {"t": ms, "edit": {parameters}} or "drag", "zoom", "scroll" [x, y], "resize" [w, h]
+	struct Event
+	{
+		double          time;
+		EventType       type;
+		TransformParams params;
+		bool            dragging;
+		double          zoom;
+		QPoint          position;
+		QSize           size;
+	};
+
+	bool startRecording(const QString & fileName, QString * error = nullptr);
+//prints the latency of the recorded session to stderr
+	void stopRecording();
+
+//no-ops unless recording; each but recordDrag() also starts a latency measurement
+	void recordEdit(const TransformParams & params);
+	void recordDrag(bool dragging);
+	void recordZoom(double zoom);
+	void recordScroll(const QPoint & position);
+	void recordResize(const QSize & size);
+
+//called once a frame is painted: every input since the last frame is presented by it, all but the newest were dropped
+	void presented();
+
+	QVector<Event> read(const QString & fileName, QString * error = nullptr);
+
+//ColorTester --replay <session> <image> [--repeat n]
+	int replay(const QStringList & arguments);
+}
+
+#endif // SESSIONRECORDER_H
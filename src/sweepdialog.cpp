@@ -0,0 +1,215 @@
+#include "sweepdialog.h"
+#include "ui_sweepdialog.h"
+#include "mainwindow.h"
+#include "imagetransform.h"
+#include "memoryaccountant.h"
+#include "scheduler.h"
+#include <QtConcurrent>
+#include <QFileDialog>
+#include <QDir>
+#include <QFileInfo>
+#include <QMessageBox>
+#include <QPushButton>
+
+SweepDialog::SweepDialog(MainWindow * window, QWidget *parent) :
+QDialog(parent),
+window(window),
+memory(MemoryAccountant::CategoryRenders),
+ui(new Ui::SweepDialog)
+{
+	ui->setupUi(this);
+
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setText(tr("Render"));
+	ui->transformBox->setCurrentIndex(window->renderKind == RenderAngles? 1 : window->renderKind == RenderPigments? 2 : window->renderKind == RenderHSV? 3 : 0);
+
+	addParameter();
+
+	connect(ui->addButton, &QPushButton::clicked, this, &SweepDialog::addParameter);
+	connect(ui->removeButton, &QPushButton::clicked, this, &SweepDialog::removeParameter);
+	connect(ui->browseButton, &QToolButton::clicked, this, &SweepDialog::browse);
+	connect(ui->buttonBox, &QDialogButtonBox::accepted, this, &SweepDialog::start);
+	connect(ui->buttonBox, &QDialogButtonBox::rejected, this, &SweepDialog::reject);
+
+	connect(&watcher, &QFutureWatcher<void>::progressRangeChanged, ui->progressBar, &QProgressBar::setRange);
+	connect(&watcher, &QFutureWatcher<void>::progressValueChanged, ui->progressBar, &QProgressBar::setValue);
+	connect(&watcher, &QFutureWatcher<void>::finished, this, &SweepDialog::finished);
+}
+
+SweepDialog::~SweepDialog()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	delete ui;
+}
+
+RenderKind SweepDialog::kind() const
+{
+	switch(ui->transformBox->currentIndex())
+	{
+	case 1:  return RenderAngles;
+	case 2:  return RenderPigments;
+	case 3:  return RenderHSV;
+	default: return RenderMatrix;
+	}
+}
+
+void SweepDialog::addParameter()
+{
+	int row = ui->parameterTable->rowCount();
+	ui->parameterTable->insertRow(row);
+	ui->parameterTable->setItem(row, 0, new QTableWidgetItem(QString::number(row)));
+	ui->parameterTable->setItem(row, 1, new QTableWidgetItem(QString::number(0)));
+	ui->parameterTable->setItem(row, 2, new QTableWidgetItem(QString::number(255)));
+}
+
+void SweepDialog::removeParameter()
+{
+	int row = ui->parameterTable->currentRow();
+	ui->parameterTable->removeRow(row < 0? ui->parameterTable->rowCount()-1 : row);
+}
+
+void SweepDialog::browse()
+{
+	QString name = QFileDialog::getSaveFileName(this, tr("Output Sequence"), ui->outputEdit->text());
+
+	if(!name.isEmpty())
+	{
+		ui->outputEdit->setText(name);
+	}
+}
+
+void SweepDialog::start()
+{
+	if(watcher.isRunning())
+	{
+		return;
+	}
+
+	QFileInfo output(ui->outputEdit->text());
+
+	if(ui->outputEdit->text().isEmpty() || !output.dir().exists())
+	{
+		QMessageBox::information(this, windowTitle(), tr("Choose an output file in an existing directory."));
+		return;
+	}
+
+	struct Range { int index, from, to; };
+	std::vector<Range> ranges;
+
+	for(int row = 0; row < ui->parameterTable->rowCount(); ++row)
+	{
+		auto value = [this, row](int column)
+		{
+			QTableWidgetItem * item = ui->parameterTable->item(row, column);
+			return item? item->text().toInt() : 0;
+		};
+
+		Range range{value(0), std::max(0, std::min(255, value(1))), std::max(0, std::min(255, value(2)))};
+
+		if(range.index < 0 || range.index >= window->params(kind()).parameterCount())
+		{
+			QMessageBox::information(this, windowTitle(), tr("Parameter index %1 is out of range.").arg(range.index));
+			return;
+		}
+
+		ranges.push_back(range);
+	}
+
+	original = window->original;
+	modifiers = window->modifierList();
+
+	const TransformParams base = window->params(kind());
+	const int count = ui->framesBox->value();
+	const QString suffix = output.suffix().isEmpty()? QString("png") : output.suffix();
+	const int digits = std::max(4, QString::number(count-1).length());
+
+//the swap stage can be shared unless one of pigments[3..5] is being swept
+	bool shareSwap = base.kind == RenderPigments && !ImageTransform::isDeep(original);
+
+	for(const Range & range : ranges)
+	{
+		shareSwap &= range.index < 3;
+	}
+
+	swap.clear();
+	memory.set(0);
+
+	const qint64 frameBytes = (qint64) original.bytesPerLine() * original.height();
+	const qint64 swapBytes  = shareSwap? (qint64) original.width() * original.height() * sizeof(Vector3) : 0;
+
+	if(!window->reserveMemory(memory, swapBytes + std::min(count, QThreadPool::globalInstance()->maxThreadCount()) * frameBytes))
+	{
+		QMessageBox::information(this, windowTitle(), tr("The sweep does not fit the memory budget."));
+		return;
+	}
+
+	if(shareSwap)
+	{
+		Scheduler::Scope scope(Scheduler::PriorityBulk);
+		ImageTransform::swapPigments(swap, original, base.pigments);
+	}
+
+	frames.clear();
+	frames.reserve(count);
+
+	for(int i = 0; i < count; ++i)
+	{
+		Frame frame;
+		frame.params   = base;
+		frame.written  = false;
+		frame.filename = QString("%1/%2_%3.%4")
+			.arg(output.path(), output.completeBaseName())
+			.arg(i, digits, 10, QChar('0'))
+			.arg(suffix);
+
+		for(const Range & range : ranges)
+		{
+			*frame.params.parameter(range.index) = qRound(range.from + (range.to - range.from) * (double) i / (count-1));
+		}
+
+		frames.push_back(frame);
+	}
+
+	const std::vector<Vector3> * shared = swap.empty()? nullptr : &swap;
+
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(false);
+
+//QtConcurrent queues its tasks at the pool priority of bulk work, the scope puts the renders in that class too
+	watcher.setFuture(QtConcurrent::map(frames, [this, shared](Frame & frame)
+	{
+		Scheduler::Scope scope(Scheduler::PriorityBulk);
+		QImage image = ImageTransform::render(original, modifiers, frame.params, shared, nullptr, 1);
+		frame.written = image.save(frame.filename);
+	}));
+}
+
+void SweepDialog::finished()
+{
+	ui->buttonBox->button(QDialogButtonBox::Ok)->setEnabled(true);
+	memory.set(0);
+
+	if(watcher.isCanceled())
+	{
+		return;
+	}
+
+	int failed = 0;
+	for(const Frame & frame : frames)
+	{
+		failed += !frame.written;
+	}
+
+	if(failed)
+	{
+		QMessageBox::information(this, windowTitle(), tr("Could not write %1 of %2 frames.").arg(failed).arg(frames.size()));
+	}
+
+	swap.clear();
+}
+
+void SweepDialog::reject()
+{
+	watcher.cancel();
+	watcher.waitForFinished();
+	QDialog::reject();
+}
@@ -0,0 +1,59 @@
+#ifndef SWEEPDIALOG_H
+#define SWEEPDIALOG_H
+#include "colortransform.h"
+#include "memoryaccountant.h"
+#include <QDialog>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QVector>
+#include <vector>
+
+class MainWindow;
+
+namespace Ui {
+class SweepDialog;
+}
+
+class SweepDialog : public QDialog
+{
+	Q_OBJECT
+
+public:
+	explicit SweepDialog(MainWindow * window, QWidget *parent = 0);
+	~SweepDialog();
+
+	void addParameter();
+	void removeParameter();
+	void browse();
+	void start();
+	void finished();
+
+	void reject() Q_DECL_OVERRIDE;
+
+	struct Frame
+	{
+		TransformParams params;
+		QString         filename;
+		bool            written;
+	};
+
+private:
+	RenderKind kind() const;
+
+	MainWindow * window;
+
+//shared by every frame of a sweep
+	QImage original;
+	QVector<QImage> modifiers;
+	std::vector<Vector3> swap;
+
+	QVector<Frame> frames;
+	QFutureWatcher<void> watcher;
+
+//the swap stage and one render per pool thread, reserved before the sweep starts
+	MemoryAccountant::Account memory;
+
+	Ui::SweepDialog *ui;
+};
+
+#endif // SWEEPDIALOG_H
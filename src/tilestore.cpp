@@ -0,0 +1,128 @@
+#include "tilestore.h"
+#include "imagetransform.h"
+#include "scheduler.h"
+#include <QPainter>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+
+static const int tileBudget = 64*1024;
+
+TileStore::TileStore() :
+	imageKey(0),
+	zoom(1.0)
+{
+	tiles.setMaxCost(tileBudget);
+}
+
+void TileStore::clear()
+{
+	tiles.clear();
+	imageKey = 0;
+}
+
+int TileStore::cost() const
+{
+	return tiles.totalCost();
+}
+
+void TileStore::draw(QPainter & painter, const QRect & exposed, const QImage & image, double zoom, QPoint offset)
+{
+	if(image.isNull())
+	{
+		return;
+	}
+
+	draw(painter, exposed, image.size(), image.cacheKey(), [&image](const QRect & source, const QSize &)
+	{
+		return ImageTransform::region(image, source);
+	}, zoom, offset);
+}
+
+void TileStore::draw(QPainter & painter, const QRect & exposed, QSize size, qint64 key, const Source & source, double zoom, QPoint offset)
+{
+	if(size.isEmpty())
+	{
+		return;
+	}
+
+	if(key != imageKey || zoom != this->zoom)
+	{
+		tiles.clear();
+		imageKey   = key;
+		this->zoom = zoom;
+	}
+
+	const QRect bounds(QPoint(0, 0), QSize(std::ceil(size.width() * zoom), std::ceil(size.height() * zoom)));
+	const QRect content = exposed.translated(offset) & bounds;
+
+	if(content.isEmpty())
+	{
+		return;
+	}
+
+	struct Missing
+	{
+		quint64 key;
+		QRect   rect;
+		QRect   source;
+		QImage  image;
+	};
+
+	QVector<Missing> missing;
+
+	for(int y = content.top() / TileSize; y <= content.bottom() / TileSize; ++y)
+	{
+		for(int x = content.left() / TileSize; x <= content.right() / TileSize; ++x)
+		{
+			const quint64 key = ((quint64) (uint32_t) y << 32) | (uint32_t) x;
+
+			if(tiles.contains(key))
+			{
+				continue;
+			}
+
+			const QRect rect = QRect(x * TileSize, y * TileSize, TileSize, TileSize) & bounds;
+
+//the source region the tile covers, padded so partial pixels at the edges are drawn too
+			const QRect region = QRect(QPoint(std::floor(rect.left() / zoom) - 1, std::floor(rect.top() / zoom) - 1),
+									   QPoint(std::ceil((rect.right()+1) / zoom) + 1, std::ceil((rect.bottom()+1) / zoom) + 1)) & QRect(QPoint(0, 0), size);
+
+			missing.push_back(Missing{key, rect, region, QImage()});
+		}
+	}
+
+//sources may be expensive (transformed on demand), so the missing tiles of a paint are produced together
+	Missing * items = missing.data();
+
+	Scheduler::map(Scheduler::PriorityInteractive, missing.size(), [items, &source, zoom](int index)
+	{
+		Missing & it = items[index];
+		it.image = source(it.source, it.source.size().boundedTo(QSize(std::ceil(it.source.width() * zoom), std::ceil(it.source.height() * zoom))));
+	});
+
+	for(const Missing & it : missing)
+	{
+		QPixmap * pixmap = new QPixmap(it.rect.size());
+		pixmap->fill(Qt::transparent);
+
+		QPainter tile(pixmap);
+		tile.translate(-it.rect.topLeft());
+		tile.scale(zoom, zoom);
+		tile.drawImage(QRectF(it.source), it.image);
+		tile.end();
+
+		tiles.insert(it.key, pixmap, std::max(1, it.rect.width() * it.rect.height() * 4 / 1024));
+	}
+
+	for(int y = content.top() / TileSize; y <= content.bottom() / TileSize; ++y)
+	{
+		for(int x = content.left() / TileSize; x <= content.right() / TileSize; ++x)
+		{
+			if(QPixmap * pixmap = tiles.object(((quint64) (uint32_t) y << 32) | (uint32_t) x))
+			{
+				painter.drawPixmap(QPoint(x * TileSize, y * TileSize) - offset, *pixmap);
+			}
+		}
+	}
+}
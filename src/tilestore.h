@@ -0,0 +1,38 @@
+#ifndef TILESTORE_H
+#define TILESTORE_H
+#include <QCache>
+#include <QImage>
+#include <QPixmap>
+#include <functional>
+
+class QPainter;
+
+//display-ready pixmaps of an image at the current zoom, in fixed size tiles of the view
+class TileStore
+{
+public:
+	enum { TileSize = 256 };
+
+//produces the pixels of a source rect of the image, at most size large; called from worker threads
+	typedef std::function<QImage (const QRect & source, const QSize & size)> Source;
+
+	TileStore();
+
+//exposed and offset are in view pixels, offset being where the view's top left lands in the zoomed image
+	void draw(QPainter & painter, const QRect & exposed, const QImage & image, double zoom, QPoint offset);
+//the image is only known by size and source; tiles are kept while key and zoom stay the same
+	void draw(QPainter & painter, const QRect & exposed, QSize size, qint64 key, const Source & source, double zoom, QPoint offset);
+	void clear();
+
+//in KiB
+	int cost() const;
+
+private:
+	qint64 imageKey;
+	double zoom;
+
+//cost is in KiB
+	QCache<quint64, QPixmap> tiles;
+};
+
+#endif // TILESTORE_H
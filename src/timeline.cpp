@@ -0,0 +1,30 @@
+#include "timeline.h"
+#include <QElapsedTimer>
+#include <cstdio>
+
+namespace Timeline
+{
+
+static QElapsedTimer clock;
+static bool          enabled = false;
+
+void start()
+{
+	clock.start();
+}
+
+void setEnabled(bool enabled)
+{
+	Timeline::enabled = enabled;
+}
+
+void mark(const char * event)
+{
+	if(enabled)
+	{
+		fprintf(stderr, "[%8.1f ms] %s\n", clock.nsecsElapsed() / 1e6, event);
+		fflush(stderr);
+	}
+}
+
+}
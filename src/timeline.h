@@ -0,0 +1,12 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+//startup milestones in milliseconds since main(), printed to stderr when enabled with --timeline
+namespace Timeline
+{
+	void start();
+	void setEnabled(bool enabled);
+	void mark(const char * event);
+}
+
+#endif // TIMELINE_H
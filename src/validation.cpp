@@ -0,0 +1,679 @@
+#include "validation.h"
+#include "colortransform.h"
+#include "quaternion.h"
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QRgb>
+#include <QVector>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#ifndef M_PI
+#define M_PI 3.14159265358
+#endif
+
+//the per-pixel code as it was before the row kernels, kept verbatim as the reference
+namespace Reference
+{
+
+static uint8_t multiplyRow(const float * row, const uint8_t * colors)
+{
+	float r = 0;
+	for(int i = 0; i < MATRIX_COLS; ++i)
+	{
+		r += colors[i] * row[i];
+	}
+
+	return r < 0? 0 : r < 255? (uint8_t) r : 255;
+}
+
+static QRgb negate(QRgb pixel)
+{
+	return qRgba(-qRed(pixel) & 0xFF, -qGreen(pixel) & 0xFF, -qBlue(pixel) & 0xFF, qAlpha(pixel));
+}
+
+static QRgb matrix(QRgb pixel, QRgb modifier, const uint8_t * matrix)
+{
+	float mat[MATRIX_SIZE];
+
+	for(size_t y = 0; y < MATRIX_ROWS; ++y)
+	{
+		float sum = 0;
+		for(size_t x = 0; x < MATRIX_COLS; ++x)
+		{
+			int i = y*MATRIX_COLS + x;
+			mat[i] = matrix[i] / 255.0;
+			sum += mat[i];
+		}
+
+		if(sum > 1.0)
+		{
+			for(size_t x = 0; x < MATRIX_COLS; ++x)
+			{
+				int i = y*MATRIX_COLS + x;
+				mat[i] = mat[i] / sum;
+			}
+		}
+	}
+
+	uint8_t colors[MATRIX_COLS];
+
+	colors[0] = qRed(pixel);
+	colors[1] = qGreen(pixel);
+	colors[2] = qBlue(pixel);
+	colors[3] = qRed(modifier);
+	colors[4] = qGreen(modifier);
+
+	uint8_t red   = multiplyRow(mat + 0*MATRIX_COLS, colors);
+	uint8_t green = multiplyRow(mat + 1*MATRIX_COLS, colors);
+	uint8_t blue  = multiplyRow(mat + 2*MATRIX_COLS, colors);
+	uint8_t alpha = qAlpha(pixel);
+
+	return qRgba(red, green, blue, alpha);
+}
+
+static QRgb angles(QRgb pixel, const uint8_t * angles)
+{
+	Quaternion q(angles[0] * M_PI / 128, angles[1] * M_PI / 128, angles[2] * M_PI / 128);
+
+	Vector3 c = Vector3::fromColor(qRed(pixel), qGreen(pixel), qBlue(pixel));
+	float length = c.length();
+	c = q.rotate(c);
+	c.normalize();
+	c = c * length;
+	return qRgba(c.red(), c.green(), c.blue(), qAlpha(pixel));
+}
+
+static Vector3 pigments(Vector3 color, const uint8_t * pigments)
+{
+	float Pr = (pigments[0]/128.f);
+	float Pg = (pigments[1]/128.f);
+	float Pb = (pigments[2]/128.f);
+
+	const float swap_rg = (pigments[3] > 128? pigments[3] - 128 : 128 - pigments[3])/128.f;
+	const float swap_gb = (pigments[4] > 128? pigments[4] - 128 : 128 - pigments[4])/128.f;
+	const float swap_rb = (pigments[5] > 128? pigments[5] - 128 : 128 - pigments[5])/128.f;
+
+	float brightness = (color.x + color.y+color.z)/3;
+
+	float t = (brightness)*(1-brightness);
+
+	float chroma = std::max(color.x, std::max(color.y, color.z)) -  std::min(color.x, std::min(color.y, color.z));
+	float db = (Pr + Pg + Pb)/6 -.5;
+
+	color = Vector3(color.x*(1-swap_rg)*(1-swap_rb) + color.y*(swap_rg) + color.z*(swap_rb)
+	,
+					color.y*(1-swap_rg)*(1-swap_gb) + color.x*(swap_rg) + color.z*(swap_gb)
+	,
+					color.z*(1-swap_gb)*(1-swap_rb) + color.x*(swap_rb) + color.y*(swap_gb)
+	);
+
+	color.x = color.x*(1-chroma) + (Pr <= 1.f? Pr*color.x : color.x + (1-color.x)*(Pr-1))*chroma + db;
+	color.y = color.y*(1-chroma) + (Pg <= 1.f? Pg*color.y : color.y + (1-color.y)*(Pg-1))*chroma + db;
+	color.z = color.z*(1-chroma) + (Pb <= 1.f? Pb*color.z : color.z + (1-color.z)*(Pb-1))*chroma + db;
+
+	color.x = std::max(0.f, std::min(1.f, color.x));
+	color.y = std::max(0.f, std::min(1.f, color.y));
+	color.z = std::max(0.f, std::min(1.f, color.z));
+
+	float luma = (color.x + color.y+color.z)/3;
+
+	luma  = (brightness*(1-t) + luma*t) - luma;
+
+	color.x += luma;
+	color.y += luma;
+	color.z += luma;
+
+	color.x = std::max(0.f, std::min(1.f, color.x));
+	color.y = std::max(0.f, std::min(1.f, color.y));
+	color.z = std::max(0.f, std::min(1.f, color.z));
+
+	return color;
+}
+
+static QRgb pigments(QRgb px, const uint8_t * pigments)
+{
+	Vector3 color = Reference::pigments(Vector3(qRed(px)/256.f, qGreen(px)/256.f, qBlue(px)/256.f), pigments);
+	return qRgba(color.x*255, color.y*255, color.z*255, qAlpha(px));
+}
+
+static Vector3 TransformHSV(
+        const Vector3 &in,  // color to transform
+        float H,          // hue shift (in degrees)
+        float S,          // saturation multiplier (scalar)
+        float V           // value multiplier (scalar)
+    )
+{
+
+
+    float VSU = V*S*cos(H);
+    float VSW = V*S*sin(H);
+
+    Vector3 ret;
+    ret.x = (.299*V+.701*VSU+.168*VSW)*in.x
+        + (.587*V-.587*VSU+.330*VSW)*in.y
+        + (.114*V-.114*VSU-.497*VSW)*in.z;
+    ret.y = (.299*V-.299*VSU-.328*VSW)*in.x
+        + (.587*V+.413*VSU+.035*VSW)*in.y
+        + (.114*V-.114*VSU+.292*VSW)*in.z;
+    ret.z = (.299*V-.3*VSU+1.25*VSW)*in.x
+        + (.587*V-.588*VSU-1.05*VSW)*in.y
+        + (.114*V+.886*VSU-.203*VSW)*in.z;
+    return ret;
+}
+
+static int truncate(float v)
+{
+	return v < 0? 0 : v < 255? (int) v : 255;
+}
+
+//TransformHSV was never wired up, so its reference is the formula itself applied to 0-255 components
+static QRgb hsv(QRgb pixel, const uint8_t * hsv)
+{
+	Vector3 c = TransformHSV(Vector3(qRed(pixel), qGreen(pixel), qBlue(pixel)), hsv[0] * M_PI / 128, hsv[1] / 128.f, hsv[2] / 128.f);
+	return qRgba(truncate(c.x), truncate(c.y), truncate(c.z), qAlpha(pixel));
+}
+
+//linear light spelled out: pow() to decode, the transform on the decoded values, pow() to encode and round
+static double decode(int v)
+{
+	const double c = v / 255.0;
+	return (c <= 0.04045? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4)) * 255;
+}
+
+static int encode(double v)
+{
+	const double c = std::max(0.0, std::min(255.0, v)) / 255;
+	return (int) std::lround((c <= 0.0031308? c * 12.92 : 1.055 * std::pow(c, 1/2.4) - 0.055) * 255);
+}
+
+static QRgb linearLight(QRgb pixel, QRgb modifier, const TransformParams & params)
+{
+	const double c[MATRIX_COLS] = { decode(qRed(pixel)), decode(qGreen(pixel)), decode(qBlue(pixel)), decode(qRed(modifier)), decode(qGreen(modifier)) };
+	double out[3] = { c[0], c[1], c[2] };
+
+	switch(params.kind)
+	{
+	case RenderMatrix:
+		for(int y = 0; y < MATRIX_ROWS; ++y)
+		{
+			double sum = 0;
+			for(int x = 0; x < MATRIX_COLS; ++x)
+				sum += params.matrix[y*MATRIX_COLS + x] / 255.0;
+
+			out[y] = 0;
+			for(int x = 0; x < MATRIX_COLS; ++x)
+				out[y] += c[x] * params.matrix[y*MATRIX_COLS + x] / 255.0 / std::max(1.0, sum);
+		}
+		break;
+	case RenderAngles:
+	{
+		Quaternion q(params.angles[0] * M_PI / 128, params.angles[1] * M_PI / 128, params.angles[2] * M_PI / 128);
+		Vector3 v((c[0] - 127) / 128, (c[1] - 127) / 128, (c[2] - 127) / 128);
+		float length = v.length();
+		v = q.rotate(v);
+		v.normalize();
+		v = v * length;
+		out[0] = v.x * 128 + 127;
+		out[1] = v.y * 128 + 127;
+		out[2] = v.z * 128 + 127;
+	} break;
+	case RenderPigments:
+	{
+		Vector3 v = pigments(Vector3(c[0]/256, c[1]/256, c[2]/256), params.pigments);
+		out[0] = v.x * 255;
+		out[1] = v.y * 255;
+		out[2] = v.z * 255;
+	} break;
+	case RenderHSV:
+	{
+		Vector3 v = TransformHSV(Vector3(c[0], c[1], c[2]), params.hsv[0] * M_PI / 128, params.hsv[1] / 128.f, params.hsv[2] / 128.f);
+		out[0] = v.x;
+		out[1] = v.y;
+		out[2] = v.z;
+	} break;
+	default:
+		break;
+	}
+
+	return qRgba(encode(out[0]), encode(out[1]), encode(out[2]), qAlpha(pixel));
+}
+
+static QRgb render(QRgb pixel, QRgb modifier, const TransformParams & params)
+{
+	if(params.linear && params.kind != RenderNegate)
+	{
+		return linearLight(pixel, modifier, params);
+	}
+
+	switch(params.kind)
+	{
+	case RenderMatrix:   return matrix(pixel, modifier, params.matrix);
+	case RenderAngles:   return angles(pixel, params.angles);
+	case RenderPigments: return pigments(pixel, params.pigments);
+	case RenderNegate:   return negate(pixel);
+	case RenderHSV:      return hsv(pixel, params.hsv);
+	default:             return pixel;
+	}
+}
+
+}
+
+namespace Validation
+{
+
+//one block is every green/blue combination for a single red value
+static const int blockWidth = 1 << 16;
+static const int alphas[]   = { 1, 128, 255 };
+
+struct Variant
+{
+	const char * name;
+	RenderKind   kind;
+	std::function<void (uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)> run;
+//differences the variant is allowed on top of --tolerance, for kernels that reorder float math
+	int bound;
+//run with params.linear set, against the linear light reference
+	bool linear;
+};
+
+struct Errors
+{
+	uint64_t histogram[4][256];
+//time spent inside the variant alone, summed over the worker threads
+	uint64_t nanoseconds;
+	uint64_t pixels;
+
+	Errors() { clear(); }
+	void clear() { memset(histogram, 0, sizeof(histogram)); nanoseconds = 0; pixels = 0; }
+
+	void merge(const Errors & it)
+	{
+		for(int c = 0; c < 4; ++c)
+			for(int i = 0; i < 256; ++i)
+				histogram[c][i] += it.histogram[c][i];
+
+		nanoseconds += it.nanoseconds;
+		pixels      += it.pixels;
+	}
+
+	int maximum(int channel) const
+	{
+		for(int i = 255; i > 0; --i)
+			if(histogram[channel][i]) return i;
+		return 0;
+	}
+};
+
+static std::vector<Variant> variants()
+{
+	std::vector<Variant> list;
+
+	list.push_back({"negate", RenderNegate, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams &)
+	{
+		ColorTransform::negateRow(dst, src, width);
+	}, 0, false});
+
+	list.push_back({"matrix", RenderMatrix, [](uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)
+	{
+		float mat[MATRIX_SIZE];
+		ColorTransform::prepareMatrix(mat, params.matrix);
+		ColorTransform::matrixRow(dst, src, mod, width, mat);
+	}, 0, false});
+
+//renders with a different red row first, then patches only the red channel like MainWindow::applyMatrix
+	list.push_back({"matrix-incremental", RenderMatrix, [](uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)
+	{
+		TransformParams stale = params;
+		for(int x = 0; x < MATRIX_COLS; ++x)
+		{
+			stale.matrix[x] ^= 0x5A;
+		}
+
+		float mat[MATRIX_SIZE];
+		ColorTransform::prepareMatrix(mat, stale.matrix);
+		ColorTransform::matrixRow(dst, src, mod, width, mat);
+
+		ColorTransform::prepareMatrix(mat, params.matrix);
+		ColorTransform::matrixRow(dst, src, mod, width, mat, 0x01);
+	}, 0, false});
+
+	list.push_back({"angles", RenderAngles, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		ColorTransform::anglesRow(dst, src, width, ColorTransform::prepareAngles(params.angles));
+	}, 0, false});
+
+	list.push_back({"pigments", RenderPigments, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		std::vector<Vector3> swap(width);
+		ColorTransform::swapRow(swap.data(), src, width, params.pigments);
+		ColorTransform::tintRow(dst, src, swap.data(), width, params.pigments);
+	}, 0, false});
+
+//prepareHSV folds the coefficients in double, the reference mixes float and double per pixel
+	list.push_back({"hsv", RenderHSV, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		float mat[9];
+		ColorTransform::prepareHSV(mat, params.hsv);
+		ColorTransform::hsvRow(dst, src, width, mat);
+	}, 1, false});
+
+//quality tiers, each with the largest difference it is documented to have
+	list.push_back({"angles-fast", RenderAngles, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		ColorTransform::anglesRowFast(dst, src, width, ColorTransform::prepareAngles(params.angles));
+	}, 1, false});
+
+	list.push_back({"pigments-fast", RenderPigments, [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		ColorTransform::pigmentsRowFast(dst, src, width, params.pigments);
+	}, 1, false});
+
+//a table serves a whole image, so it is only rebuilt when the parameters change, like in ImageTransform::apply
+	auto preview = [](uint32_t * dst, const uint32_t * src, const uint32_t *, int width, const TransformParams & params)
+	{
+		thread_local std::vector<uint32_t> lut;
+		thread_local TransformParams       built;
+
+		if(lut.empty() || built.kind != params.kind || memcmp(built.angles, params.angles, sizeof(params.angles))
+		|| memcmp(built.pigments, params.pigments, sizeof(params.pigments)) || memcmp(built.hsv, params.hsv, sizeof(params.hsv)))
+		{
+			lut.resize(ColorTransform::LutSize);
+			ColorTransform::buildLut(lut.data(), params);
+			built = params;
+		}
+
+		ColorTransform::lutRow(dst, src, width, lut.data());
+	};
+
+	list.push_back({"angles-preview", RenderAngles, preview, 4, false});
+	list.push_back({"pigments-preview", RenderPigments, preview, 8, false});
+	list.push_back({"hsv-preview", RenderHSV, preview, 16, false});
+
+//16 bit kernels on the 8 bit gamut widened by 257, truncated back like the reference; the widening counts in their ns/px
+	auto deep = [](uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)
+	{
+		std::vector<uint64_t> src64(width), mod64(width), dst64(width, 0);
+
+		for(int x = 0; x < width; ++x)
+		{
+			src64[x] = ColorTransform::rgba64(qRed(src[x])*257, qGreen(src[x])*257, qBlue(src[x])*257, qAlpha(src[x])*257);
+			mod64[x] = ColorTransform::rgba64(qRed(mod[x])*257, qGreen(mod[x])*257, qBlue(mod[x])*257, qAlpha(mod[x])*257);
+		}
+
+		float mat[MATRIX_SIZE], offset[3];
+
+		if(ColorTransform::prepareAffine(mat, offset, params))
+			ColorTransform::affineRow64(dst64.data(), src64.data(), mod64.data(), width, mat, offset);
+		else if(params.kind == RenderPigments)
+			ColorTransform::pigmentsRow64(dst64.data(), src64.data(), width, params.pigments);
+		else
+			ColorTransform::negateRow64(dst64.data(), src64.data(), width);
+
+		for(int x = 0; x < width; ++x)
+		{
+			const uint64_t p = dst64[x];
+			dst[x] = qRgba(ColorTransform::red16(p) / 257, ColorTransform::green16(p) / 257, ColorTransform::blue16(p) / 257, ColorTransform::alpha16(p) / 257);
+		}
+	};
+
+	list.push_back({"negate-16", RenderNegate, deep, 1, false});
+	list.push_back({"matrix-16", RenderMatrix, deep, 1, false});
+	list.push_back({"angles-16", RenderAngles, deep, 1, false});
+	list.push_back({"pigments-16", RenderPigments, deep, 1, false});
+	list.push_back({"hsv-16", RenderHSV, deep, 1, false});
+
+//linear light against pow() per pixel; the ns/px next to the gamma variants above is the cost of decoding and encoding
+	auto linear = [](uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)
+	{
+		float mat[MATRIX_SIZE], offset[3];
+
+		if(ColorTransform::prepareAffine(mat, offset, params))
+			ColorTransform::affineRowLinear(dst, src, mod, width, mat, offset);
+		else
+			ColorTransform::pigmentsRowLinear(dst, src, width, params.pigments);
+	};
+
+	list.push_back({"matrix-linear", RenderMatrix, linear, 1, true});
+	list.push_back({"angles-linear", RenderAngles, linear, 1, true});
+	list.push_back({"pigments-linear", RenderPigments, linear, 1, true});
+	list.push_back({"hsv-linear", RenderHSV, linear, 1, true});
+
+//the wide matrix with the classic columns first and any further ones weighted 0, so the classic reference still holds
+	auto wide = [](int count, int depth)
+	{
+		return [count, depth](uint32_t * dst, const uint32_t * src, const uint32_t * mod, int width, const TransformParams & params)
+		{
+			TransformParams widened = params;
+			widened.modifierCount = count;
+			memset(widened.wide, 0, sizeof(widened.wide));
+
+			for(int y = 0; y < MATRIX_ROWS; ++y)
+			{
+				memcpy(widened.wide + y*WIDE_COLS, params.matrix + y*MATRIX_COLS, MATRIX_COLS);
+			}
+
+			float mat[WIDE_SIZE];
+			ColorTransform::prepareWide(mat, widened);
+
+			ColorTransform::ModifierRow rows[MODIFIER_CHANNELS];
+
+			if(depth == 8)
+			{
+				for(int i = 0; i < count; ++i)
+					rows[i] = ColorTransform::ModifierRow{mod, i % 4};
+
+				if(params.linear)
+					ColorTransform::wideRowLinear(dst, src, rows, count, width, mat);
+				else
+					ColorTransform::wideRow(dst, src, rows, count, width, mat);
+				return;
+			}
+
+			std::vector<uint64_t> src64(width), mod64(width), dst64(width, 0);
+
+			for(int x = 0; x < width; ++x)
+			{
+				src64[x] = ColorTransform::rgba64(qRed(src[x])*257, qGreen(src[x])*257, qBlue(src[x])*257, qAlpha(src[x])*257);
+				mod64[x] = ColorTransform::rgba64(qRed(mod[x])*257, qGreen(mod[x])*257, qBlue(mod[x])*257, qAlpha(mod[x])*257);
+			}
+
+			for(int i = 0; i < count; ++i)
+				rows[i] = ColorTransform::ModifierRow{mod64.data(), i % 4};
+
+			ColorTransform::wideRow64(dst64.data(), src64.data(), rows, count, width, mat);
+
+			for(int x = 0; x < width; ++x)
+			{
+				const uint64_t p = dst64[x];
+				dst[x] = qRgba(ColorTransform::red16(p) / 257, ColorTransform::green16(p) / 257, ColorTransform::blue16(p) / 257, ColorTransform::alpha16(p) / 257);
+			}
+		};
+	};
+
+	list.push_back({"matrix-wide", RenderMatrix, wide(2, 8), 0, false});
+	list.push_back({"matrix-wide-8", RenderMatrix, wide(8, 8), 0, false});
+	list.push_back({"matrix-wide-16", RenderMatrix, wide(8, 16), 1, false});
+	list.push_back({"matrix-wide-linear", RenderMatrix, wide(8, 8), 1, true});
+
+	return list;
+}
+
+//defaults, both extremes and pseudo random settings, the same on every run
+static std::vector<TransformParams> parameterSets(RenderKind kind, int samples)
+{
+	std::vector<TransformParams> sets;
+
+	TransformParams params;
+	params.kind = kind;
+
+	memset(params.matrix, 0, sizeof(params.matrix));
+	for(int y = 0; y < MATRIX_ROWS; ++y)
+	{
+		params.matrix[y + y*MATRIX_COLS] = 255;
+	}
+	memset(params.angles, 0, sizeof(params.angles));
+	memset(params.pigments, 128, sizeof(params.pigments));
+	params.hsv[0] = 0;
+	params.hsv[1] = 128;
+	params.hsv[2] = 128;
+	params.linear = false;
+	params.modifierCount = 0;
+	memset(params.wide, 0, sizeof(params.wide));
+	for(int i = 0; i < MODIFIER_CHANNELS; ++i)
+	{
+		params.modifierChannel[i] = i;
+	}
+	sets.push_back(params);
+
+	if(kind == RenderNegate)
+	{
+		return sets;
+	}
+
+	for(int value : { 0, 255 })
+	{
+		TransformParams extreme = params;
+		memset(extreme.matrix, value, sizeof(extreme.matrix));
+		memset(extreme.angles, value, sizeof(extreme.angles));
+		memset(extreme.pigments, value, sizeof(extreme.pigments));
+		memset(extreme.hsv, value, sizeof(extreme.hsv));
+		sets.push_back(extreme);
+	}
+
+	uint32_t seed = 0x12345678u + kind;
+	for(int i = 0; i < samples; ++i)
+	{
+		TransformParams random = params;
+		for(int j = 0; j < random.parameterCount(); ++j)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			*random.parameter(j) = seed >> 24;
+		}
+		sets.push_back(random);
+	}
+
+	return sets;
+}
+
+static Errors validate(const Variant & variant, const TransformParams & params)
+{
+	QVector<int> blocks(256 * (int) (sizeof(alphas) / sizeof(alphas[0])));
+	for(int i = 0; i < blocks.size(); ++i)
+	{
+		blocks[i] = i;
+	}
+
+	std::function<Errors (const int &)> check = [&](const int & block)
+	{
+		const int red   = block & 0xFF;
+		const int alpha = alphas[block >> 8];
+
+		std::vector<uint32_t> src(blockWidth), mod(blockWidth), dst(blockWidth, 0);
+
+		for(int i = 0; i < blockWidth; ++i)
+		{
+			src[i] = qRgba(red, i >> 8, i & 0xFF, alpha);
+			mod[i] = qRgba((i * 7 + red) & 0xFF, (i >> 3) & 0xFF, 0, 255);
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+		variant.run(dst.data(), src.data(), mod.data(), blockWidth, params);
+
+		Errors errors;
+		errors.nanoseconds = timer.nsecsElapsed();
+		errors.pixels      = blockWidth;
+
+		for(int i = 0; i < blockWidth; ++i)
+		{
+			QRgb expected = Reference::render(src[i], mod[i], params);
+
+			++errors.histogram[0][std::abs(qRed  (expected) - qRed  (dst[i]))];
+			++errors.histogram[1][std::abs(qGreen(expected) - qGreen(dst[i]))];
+			++errors.histogram[2][std::abs(qBlue (expected) - qBlue (dst[i]))];
+			++errors.histogram[3][std::abs(qAlpha(expected) - qAlpha(dst[i]))];
+		}
+
+		return errors;
+	};
+
+	auto reduce = [](Errors & total, const Errors & it) { total.merge(it); };
+
+	return QtConcurrent::blockingMappedReduced<Errors>(blocks, check, reduce);
+}
+
+int run(const QStringList & arguments)
+{
+	QCommandLineParser parser;
+	parser.addHelpOption();
+	parser.addOption(QCommandLineOption("validate"));
+	parser.addOption(QCommandLineOption("tolerance", "Largest allowed per channel difference.", "n", "0"));
+	parser.addOption(QCommandLineOption("samples", "Random parameter sets per kernel.", "n", "8"));
+	parser.addOption(QCommandLineOption("kernel", "Only validate kernels whose name starts with this.", "name"));
+	parser.process(arguments);
+
+	const int tolerance = parser.value("tolerance").toInt();
+	const int samples   = parser.value("samples").toInt();
+	const QString only  = parser.value("kernel");
+
+	bool passed = true;
+
+	for(const Variant & variant : variants())
+	{
+		if(!QString(variant.name).startsWith(only))
+		{
+			continue;
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+
+		Errors errors;
+
+		for(TransformParams params : parameterSets(variant.kind, samples))
+		{
+			params.linear = variant.linear;
+			errors.merge(validate(variant, params));
+		}
+
+		int worst = 0;
+		for(int c = 0; c < 4; ++c)
+		{
+			worst = std::max(worst, errors.maximum(c));
+		}
+
+		const bool ok = worst <= tolerance + variant.bound;
+		passed &= ok;
+
+		printf("%-20s max error r %d g %d b %d a %d  %6.1f ns/px  %6.1fs  %s\n", variant.name,
+			errors.maximum(0), errors.maximum(1), errors.maximum(2), errors.maximum(3),
+			errors.pixels? errors.nanoseconds / (double) errors.pixels : 0.,
+			timer.elapsed() / 1000.0, ok? "ok" : "FAILED");
+
+		if(worst > 0)
+		{
+			for(int i = 1; i <= worst; ++i)
+			{
+				if(errors.histogram[0][i] || errors.histogram[1][i] || errors.histogram[2][i] || errors.histogram[3][i])
+				{
+					printf("    error %3d: r %llu g %llu b %llu a %llu\n", i,
+						(unsigned long long) errors.histogram[0][i], (unsigned long long) errors.histogram[1][i],
+						(unsigned long long) errors.histogram[2][i], (unsigned long long) errors.histogram[3][i]);
+				}
+			}
+		}
+
+		fflush(stdout);
+	}
+
+	return passed? 0 : 1;
+}
+
+}
@@ -0,0 +1,12 @@
+#ifndef VALIDATION_H
+#define VALIDATION_H
+#include <QStringList>
+
+//compares every kernel variant against the original per-pixel code over the whole 24 bit gamut, timing each
+//ColorTester --validate [--tolerance n] [--samples n] [--kernel name]
+namespace Validation
+{
+	int run(const QStringList & arguments);
+}
+
+#endif // VALIDATION_H
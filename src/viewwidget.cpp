@@ -4,6 +4,7 @@
 #include <QWheelEvent>
 #include <QKeyEvent>
 #include <QPaintEvent>
+#include <QResizeEvent>
 
 ViewWidget::ViewWidget(QWidget *parent) : QWidget(parent)
 {
@@ -34,15 +35,31 @@ static QBrush square_color(Qt::gray);
 	QPainter painter;
 	painter.begin(this);
 
-	painter.fillRect(event->rect(), background);
-	for(int x = 0, column = 0; x < event->rect().width(); x += grid_size, ++column)
+//the checkerboard is anchored to the image so it stays seamless when the view is scrolled by a blit
+	const QRect  rect   = event->rect();
+	const QPoint offset = window->scrollOffset();
+
+	painter.fillRect(rect, background);
+	for(int column = (rect.left() + offset.x()) / grid_size; column * grid_size - offset.x() <= rect.right(); ++column)
 	{
-		for(int y = column & 0x01? grid_size : 0; y < event->rect().height(); y += grid_size*2)
+		for(int row = (rect.top() + offset.y()) / grid_size; row * grid_size - offset.y() <= rect.bottom(); ++row)
 		{
-			painter.fillRect(QRect(x, y, grid_size, grid_size), square_color);
+			if((row + column) & 0x01)
+			{
+				painter.fillRect(QRect(column * grid_size - offset.x(), row * grid_size - offset.y(), grid_size, grid_size), square_color);
+			}
 		}
 	}
 
-	window->draw(painter, size());
+	window->draw(painter, rect);
 	painter.end();
+
+	SessionRecorder::presented();
+}
+
+void ViewWidget::resizeEvent(QResizeEvent * event)
+{
+	super::resizeEvent(event);
+	SessionRecorder::recordResize(window->size());
+	window->updateScrollBars();
 }
@@ -18,6 +18,7 @@ public:
 
 	void wheelEvent				(QWheelEvent * event)   Q_DECL_OVERRIDE;
 	void paintEvent				(QPaintEvent * event)	Q_DECL_OVERRIDE;
+	void resizeEvent			(QResizeEvent * event)	Q_DECL_OVERRIDE;
 
 private:
 friend class MainWindow;